@@ -51,6 +51,10 @@ class Bitmap {
     return (start_[word_offset(pos)] >> bit_offset(pos)) & 1l;
   }
 
+  // Raw words, for kernels that work 64 bits at a time
+  uint64_t *words() { return start_; }
+  const uint64_t *words() const { return start_; }
+
   void swap(Bitmap &other) {
     std::swap(start_, other.start_);
     std::swap(end_, other.end_);
@@ -31,14 +31,14 @@ Wrappers for compiler intrinsics for atomic memory operations (AMOs)
     }
 
     template<>
-    bool compare_and_swap(float &x, const float &old_val, const float &new_val) {
+    inline bool compare_and_swap(float &x, const float &old_val, const float &new_val) {
       return __sync_bool_compare_and_swap(reinterpret_cast<uint32_t*>(&x),
                                           reinterpret_cast<const uint32_t&>(old_val),
                                           reinterpret_cast<const uint32_t&>(new_val));
     }
 
     template<>
-    bool compare_and_swap(double &x, const double &old_val, const double &new_val) {
+    inline bool compare_and_swap(double &x, const double &old_val, const double &new_val) {
       return __sync_bool_compare_and_swap(reinterpret_cast<uint64_t*>(&x),
                                           reinterpret_cast<const uint64_t&>(old_val),
                                           reinterpret_cast<const uint64_t&>(new_val));
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cstdint>
+#include <omp.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "autoselect.h"
+
+using namespace std;
+
+namespace {
+  const int kSymmetrySamples = 4096;
+
+  // Rough machine constants of the cost model: time per edge of a BFS and
+  // per level of the parallel BFS's team synchronization
+  const double kEdgeSeconds = 4e-9;
+  const double kLevelSeconds = 4e-6;
+
+  // Parallel BFSes stop paying off below this many edges per thread
+  const int64_t kMinEdgesPerThread = 1 << 15;
+
+  // BFSes the bounding engines typically need beyond the sweeps, and the
+  // brute force must beat that by this much to be picked
+  const int kBoundingBFSes = 64;
+
+  // Skew above which bottom-up levels are likely and direction tuning pays
+  const double kTuneSkew = 8;
+} // end namespace
+
+namespace Diameter {
+  GraphStats GatherStats(DiameterSolver &solver) {
+    const pvector <pvector<int> > &adjlist = solver.GetGraph();
+    const pvector <pvector<int> > &radjlist = solver.GetTranspose();
+    int V = adjlist.size();
+    GraphStats stats = {V, 0, 0, 0, 0, 0, 0};
+    if (V == 0) return stats;
+
+    int64_t num_edges = 0, max_degree = 0;
+    int hub = 0;
+    #pragma omp parallel
+    {
+      int64_t local_max = -1;
+      int local_hub = 0;
+      #pragma omp for reduction(+ : num_edges) nowait
+      for (int v = 0; v < V; v++) {
+        int64_t degree = adjlist[v].size() + radjlist[v].size();
+        num_edges += adjlist[v].size();
+        if (degree > local_max) {
+          local_max = degree;
+          local_hub = v;
+        }
+      }
+      #pragma omp critical (stats_hub)
+      if (local_max > max_degree || (local_max == max_degree && local_hub < hub)) {
+        max_degree = local_max;
+        hub = local_hub;
+      }
+    }
+    stats.num_edges = num_edges;
+    stats.max_degree = max_degree;
+    stats.degree_skew = num_edges > 0 ? max_degree / (2.0 * num_edges / V) : 0;
+
+    // The first edge of evenly spaced vertices, looked for in its head's list
+    int64_t sampled = 0, reversed = 0;
+    if (num_edges > 0) {
+      int step = max(1, V / kSymmetrySamples);
+      #pragma omp parallel for reduction(+ : sampled, reversed)
+      for (int v = 0; v < V; v += step) {
+        if (adjlist[v].size() == 0) continue;
+        int w = adjlist[v][0];
+        sampled++;
+        reversed += find(adjlist[w].begin(), adjlist[w].end(), v) != adjlist[w].end();
+      }
+    }
+    stats.symmetry = sampled > 0 ? (double)reversed / sampled : 1;
+
+    // Tuning is left to the chosen engine, so these use the default thresholds
+    pvector<int> forward, backward;
+    int out = BFSDistancesParallel(adjlist, radjlist, hub, forward);
+    int in = BFSDistancesParallel(radjlist, adjlist, hub, backward);
+    int64_t hub_scc = 0;
+    #pragma omp parallel for reduction(+ : hub_scc)
+    for (int v = 0; v < V; v++) hub_scc += forward[v] >= 0 && backward[v] >= 0;
+    stats.hub_scc = hub_scc;
+    stats.hub_height = max(out, in);
+    return stats;
+  }
+
+  EngineChoice ChooseEngine(const GraphStats &stats, int max_threads) {
+    EngineChoice choice;
+    int64_t work = stats.num_vertices + stats.num_edges;
+    int threads = (int)max<int64_t>(1, min<int64_t>(max_threads, work / kMinEdgesPerThread));
+
+    // A BFS, serially and on the parallel team; the diameter is at least
+    // the sampled height, and every level of it synchronizes the team
+    choice.serial_cost = work * kEdgeSeconds;
+    choice.parallel_cost = choice.serial_cost / threads + stats.hub_height * kLevelSeconds;
+    bool parallel_bfs = threads > 1 && choice.parallel_cost < choice.serial_cost;
+
+    // Brute force runs V independent BFSes, one per thread in parallel;
+    // the bounding engines run the sweeps and a few candidates plus setup
+    double brute_cost = stats.num_vertices * choice.serial_cost / max_threads;
+    double bounding_cost = (2 * kDefaultSweeps.count + kBoundingBFSes) *
+                           min(choice.serial_cost, choice.parallel_cost) + 4 * choice.serial_cost;
+    if (brute_cost < bounding_cost) {
+      choice.engine = max_threads > 1 ? ENGINE_PARA_SLOW : ENGINE_SLOW;
+      choice.num_threads = max_threads;
+    } else if (parallel_bfs) {
+      choice.engine = ENGINE_PARA_PAPER;
+      choice.num_threads = threads;
+    } else {
+      choice.engine = ENGINE_PAPER;
+      choice.num_threads = max_threads;  // for the concurrent sweeps
+    }
+
+    choice.tune_direction = stats.degree_skew >= kTuneSkew;
+    if (stats.symmetry >= 0.99) choice.sweep_start = SWEEP_FOUR;
+    else if (2 * stats.hub_scc >= stats.num_vertices) choice.sweep_start = SWEEP_SCC;
+    else choice.sweep_start = SWEEP_RANDOM;
+    return choice;
+  }
+
+  const char *EngineName(Engine engine) {
+    switch (engine) {
+      case ENGINE_PAPER:
+        return "paper";
+      case ENGINE_SLOW:
+        return "slow";
+      case ENGINE_PARA_SLOW:
+        return "para_slow";
+      case ENGINE_PARA_PAPER:
+        return "para_paper";
+      default:
+        return "unknown";
+    }
+  }
+
+  string DescribeChoice(const GraphStats &stats, const EngineChoice &choice) {
+    const char *starts[] = {"random", "degree", "four", "scc"};
+    char line[512];
+    snprintf(line, sizeof(line),
+             "auto: engine=%s threads=%d tune=%d sweep_start=%s"
+             " | V=%lld E=%lld max_degree=%lld skew=%.1f symmetry=%.2f hub_scc=%lld hub_height=%d"
+             " | bfs_serial=%.3gs bfs_parallel=%.3gs",
+             EngineName(choice.engine), choice.num_threads, (int)choice.tune_direction,
+             starts[choice.sweep_start], (long long)stats.num_vertices,
+             (long long)stats.num_edges, (long long)stats.max_degree, stats.degree_skew,
+             stats.symmetry, (long long)stats.hub_scc, stats.hub_height,
+             choice.serial_cost, choice.parallel_cost);
+    return line;
+  }
+} // end namespace Diameter
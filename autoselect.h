@@ -0,0 +1,49 @@
+# ifndef AUTOSELECT_H
+# define AUTOSELECT_H
+
+#include <cstdint>
+#include <string>
+#include "diameter.h"
+#include "diamrallel.h"
+
+using namespace std;
+
+namespace Diameter {
+  // What the engine choice is based on
+  struct GraphStats {
+    int64_t num_vertices, num_edges;
+    int64_t max_degree;   // out plus in
+    double degree_skew;   // max_degree over the average
+    double symmetry;      // fraction of sampled edges whose reverse exists
+    int64_t hub_scc;      // size of the SCC of the highest-degree vertex
+    int hub_height;       // larger of its forward and backward BFS heights
+  };
+
+  enum Engine {ENGINE_PAPER, ENGINE_SLOW, ENGINE_PARA_SLOW, ENGINE_PARA_PAPER};
+
+  struct EngineChoice {
+    Engine engine;
+    int num_threads;
+    bool tune_direction;
+    SweepStart sweep_start;
+    double serial_cost, parallel_cost;  // estimated seconds per BFS
+  };
+
+  // One parallel pass over the lists for degrees and a sample of edges for
+  // symmetry, then a forward and a backward parallel BFS from the
+  // highest-degree vertex. The transpose comes from (and stays in) the
+  // solver.
+  GraphStats GatherStats(DiameterSolver &solver);
+
+  // Cost model over the stats: a BFS costs its edges, split across threads
+  // in the parallel engines but paying a team synchronization per level,
+  // and the bounding engines pay a fixed number of BFSes on top of their
+  // setup where brute force pays V of them.
+  EngineChoice ChooseEngine(const GraphStats &stats, int max_threads);
+
+  const char *EngineName(Engine engine);
+
+  // One line with the stats, the choice and its estimated costs
+  string DescribeChoice(const GraphStats &stats, const EngineChoice &choice);
+} // end namespace Diameter
+# endif
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <omp.h>
+#include <stdio.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#include "ForParallelFromBeamer/platform_atomics.h"
+#include "batch.h"
+#include "diameter.h"
+#include "diamrallel.h"
+#include "graphgen.h"
+
+using namespace std;
+
+namespace {
+  bool ReadEdges(const string &filename, bool compact, vector <pair<int, int> > &edges) {
+    Generator::IdMap ids;
+    if (filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".bin") == 0) {
+      return Generator::ReadBinaryEdges(filename.c_str(), edges) &&
+             (!compact || Generator::CompactIDs(edges, ids));
+    }
+    if (compact) {
+      vector <pair<int64_t, int64_t> > raw;
+      return Generator::ReadTextEdges64(filename.c_str(), raw) &&
+             Generator::CompactIDs(raw, edges, ids);
+    }
+    FILE *in = fopen(filename.c_str(), "r");
+    if (in == NULL) return false;
+
+    for (int from, to; fscanf(in, "%d %d", &from, &to) == 2; ) {
+      edges.push_back(make_pair(from, to));
+    }
+    fclose(in);
+    return true;
+  }
+
+  int64_t FileSize(const string &filename) {
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0 ? st.st_size : 0;
+  }
+} // end namespace
+
+namespace Diameter {
+  void RunBatch(const vector<string> &filenames, bool undirected, bool compact, bool simplify,
+                const function<void(const BatchResult &)> &report) {
+    // Largest graphs first, so the last one claimed is a small one and
+    // threads run out of work at about the same time
+    vector <pair<int64_t, int> > jobs(filenames.size());
+    for (size_t i = 0; i < filenames.size(); i++) {
+      jobs[i] = make_pair(-FileSize(filenames[i]), (int)i);
+    }
+    sort(jobs.begin(), jobs.end());
+
+    int64_t next = 0;
+    #pragma omp parallel
+    {
+      BFSBuffers buf;
+      vector <pair<int, int> > edges;
+
+      for (int64_t job = fetch_and_add(next, 1); job < (int64_t)jobs.size();
+           job = fetch_and_add(next, 1)) {
+        double start = omp_get_wtime();
+        BatchResult result = {filenames[jobs[job].second], -1, 0, 0, 0};
+
+        edges.clear();
+        if (ReadEdges(result.filename, compact, edges)) {
+          if (undirected) Generator::Symmetrize(edges);
+          int64_t dropped = 0;
+          vector <vector<int> > adjlist = BuildGraph(edges, simplify, &dropped);
+          result.num_vertices = adjlist.size();
+          result.num_edges = edges.size() - dropped;
+          result.diameter = adjlist.empty() ? 0 : GetFastDiam(adjlist, buf);
+        }
+        result.seconds = omp_get_wtime() - start;
+
+        #pragma omp critical (batch_report)
+        report(result);
+      }
+    }
+  }
+
+  bool ReadManifest(const char *filename, vector<string> &filenames) {
+    FILE *in = fopen(filename, "r");
+    if (in == NULL) return false;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), in) != NULL) {
+      string name = line;
+      name.erase(name.find_last_not_of(" \t\r\n") + 1);
+      name.erase(0, name.find_first_not_of(" \t"));
+      if (!name.empty() && name[0] != '#') filenames.push_back(name);
+    }
+    fclose(in);
+    return true;
+  }
+} // end namespace Diameter
@@ -0,0 +1,32 @@
+# ifndef BATCH_H
+# define BATCH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Diameter {
+  struct BatchResult {
+    string filename;
+    int diameter;       // -1 if the file couldn't be read
+    int num_vertices;
+    int64_t num_edges;
+    double seconds;     // reading the file included
+  };
+
+  // Diameters of many small graphs in one process. Each thread takes the
+  // next unclaimed file, biggest first, and runs the serial engine on it
+  // with scratch it keeps for the whole batch. report is called once per
+  // graph as soon as it is done, never concurrently. With compact, the IDs
+  // of each graph (up to 64 bits in text files) are first relabeled densely;
+  // with simplify, lists are built as BuildGraph simplifies them.
+  void RunBatch(const vector<string> &filenames, bool undirected, bool compact, bool simplify,
+                const function<void(const BatchResult &)> &report);
+
+  // Graph file names, one per line; blank lines and # comments are skipped
+  bool ReadManifest(const char *filename, vector<string> &filenames);
+} // end namespace Diameter
+# endif
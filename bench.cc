@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <stdio.h>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+#include <omp.h>
+#include "ForParallelFromBeamer/bitmap.h"
+#include "ForParallelFromBeamer/pvector.h"
+#include "ForParallelFromBeamer/sliding_queue.h"
+#include "diamrallel.h"
+#include "graphgen.h"
+#include "kernels.h"
+
+using namespace std;
+
+// Times the BFS kernels and graph preprocessing steps one by one on a
+// generated graph, outside of any diameter run.
+
+namespace {
+  double GetTime() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+  }
+
+  // setup runs untimed before every repetition of run
+  struct Kernel {
+    string name;
+    function<void()> setup, run;
+  };
+
+  // Vertex of largest out-degree, so the BFS kernels reach most of the graph
+  int PickSource(const pvector <pvector<int> > &adjlist) {
+    int source = 0;
+    for (size_t v = 0; v < adjlist.size(); v++) {
+      if (adjlist[v].size() > adjlist[source].size()) source = v;
+    }
+    return source;
+  }
+} // end namespace
+
+int main(int argc, char** argv) {
+  int reps = 10;
+  string only;
+  Generator::GenKind gen_kind = Generator::GEN_RMAT;
+  int gen_scale = 20, gen_degree = 16;
+  unsigned long long gen_seed = 27491095;
+  bool undirected = false;
+  for (int i = 1; i < argc; ++i) {
+      if (string(argv[i]) == "--reps") {
+          if (i + 1 < argc) {
+              reps = max(1, atoi(argv[++i]));
+          } else { // Reps flag called but unspecified
+              cerr << "--reps option requires one argument." << endl;
+              return 1;
+          }
+      } else if (string(argv[i]) == "--kernel") {
+        if (i + 1 < argc) {
+            only = argv[++i];
+        } else { // Kernel flag called but unspecified
+              cerr << "--kernel option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--gen") {
+        if (i + 1 < argc && Generator::ParseKind(argv[i + 1], gen_kind)) {
+            i++;
+        } else { // Generator flag called but unspecified or unknown
+              cerr << "--gen option requires one of rmat, er, grid, path, star, maximal." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--scale" || string(argv[i]) == "--degree" ||
+                 string(argv[i]) == "--seed") {
+        if (i + 1 < argc) {
+            string flag = argv[i];
+            if (flag == "--scale") gen_scale = atoi(argv[++i]);
+            else if (flag == "--degree") gen_degree = atoi(argv[++i]);
+            else gen_seed = strtoull(argv[++i], NULL, 10);
+        } else { // Generator parameter called but unspecified
+              cerr << argv[i] << " option requires one argument." << endl;
+            return 1;
+        }
+        if (gen_scale < 0 || gen_scale > Generator::kMaxScale) {
+              cerr << "--scale option requires a value from 0 to " << Generator::kMaxScale << "."
+                   << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--undirected") undirected = true;
+      else {
+          cerr << "Unknown option " << argv[i] << endl;
+          return 1;
+      }
+  }
+
+  double start = GetTime();
+  vector <pair<int, int> > edges = Generator::Generate(gen_kind, gen_scale, gen_degree, gen_seed);
+  if (undirected) Generator::Symmetrize(edges);
+  pvector <pvector<int> > adjlist = Diameter::BuildTSGraph(edges);
+  edges.clear();
+  edges.shrink_to_fit();
+  Diameter::DiameterSolver prepared(adjlist);
+  const pvector <pvector<int> > &radjlist = prepared.GetTranspose();
+  int64_t V = adjlist.size(), num_edges = 0;
+  for (int64_t v = 0; v < V; v++) num_edges += adjlist[v].size();
+  int source = PickSource(adjlist);
+  printf("# %lld vertices, %lld edges, %d threads, built in %f seconds\n", (long long)V,
+         (long long)num_edges, omp_get_max_threads(), GetTime() - start);
+
+  pvector<int> distance(V);
+  SlidingQueue<int> queue(V);
+  Bitmap front(V), next(V);
+  vector<Kernel> kernels;
+
+  // Whole BFSes in one direction, so each kernel sees every level shape
+  kernels.push_back({"top_down", [&]() {
+    distance.fill(-1);
+    distance[source] = 0;
+    queue.reset();
+    queue.push_back(source);
+    queue.slide_window();
+  }, [&]() {
+    while (!queue.empty()) {
+      Parallel::TopDown(adjlist, distance, queue);
+      queue.slide_window();
+    }
+  }});
+  kernels.push_back({"bottom_up", [&]() {
+    distance.fill(-1);
+    distance[source] = 0;
+    front.reset();
+    front.set_bit(source);
+  }, [&]() {
+    while (Parallel::BottomUp(radjlist, distance, front, next) > 0) front.swap(next);
+  }});
+
+  // Conversions between the two frontier forms, on every other vertex
+  kernels.push_back({"queue_to_bitmap", [&]() {
+    queue.reset();
+    for (int64_t v = 0; v < V; v += 2) queue.push_back(v);
+    queue.slide_window();
+    front.reset();
+  }, [&]() {
+    Parallel::QueueToBitmap(queue, front);
+  }});
+  kernels.push_back({"bitmap_to_queue", [&]() {
+    front.reset();
+    for (int64_t v = 0; v < V; v += 2) front.set_bit(v);
+    queue.reset();
+  }, [&]() {
+    Parallel::BitmapToQueue(adjlist, front, queue);
+  }});
+
+  // The containers themselves: every thread setting and reading bits, and
+  // pushing through its buffer
+  kernels.push_back({"bitmap_ops", [&]() {
+    front.reset();
+  }, [&]() {
+    int64_t count = 0;
+    #pragma omp parallel
+    {
+      #pragma omp for
+      for (int64_t v = 0; v < V; v += 3) front.set_bit_atomic(v);
+      #pragma omp for reduction(+ : count)
+      for (int64_t v = 0; v < V; v++) count += front.get_bit(v);
+    }
+    if (count != (V + 2) / 3) fprintf(stderr, "bitmap_ops counted %lld\n", (long long)count);
+  }});
+  kernels.push_back({"queue_push", [&]() {
+    queue.reset();
+  }, [&]() {
+    #pragma omp parallel
+    {
+      QueueBuffer<int> lqueue(queue);
+      #pragma omp for nowait
+      for (int64_t v = 0; v < V; v++) lqueue.push_back(v);
+      lqueue.flush();
+    }
+    queue.slide_window();
+  }});
+
+  // Preprocessing, each time on a solver that has none of it cached
+  Diameter::DiameterSolver *solver = NULL;
+  auto fresh_solver = [&]() {
+    delete solver;
+    solver = new Diameter::DiameterSolver(adjlist);
+  };
+  kernels.push_back({"transpose", fresh_solver, [&]() { solver->GetTranspose(); }});
+  kernels.push_back({"scc", fresh_solver, [&]() { solver->GetSCC(); }});
+
+  printf("kernel\tbest\tmean\n");
+  for (const Kernel &kernel : kernels) {
+    if (!only.empty() && kernel.name != only) continue;
+    double best = 0, total = 0;
+    for (int r = 0; r < reps; r++) {
+      kernel.setup();
+      double begin = GetTime();
+      kernel.run();
+      double seconds = GetTime() - begin;
+      total += seconds;
+      best = r == 0 ? seconds : min(best, seconds);
+    }
+    printf("%s\t%f\t%f\n", kernel.name.c_str(), best, total / reps);
+    fflush(stdout);
+  }
+  delete solver;
+  return 0;
+}
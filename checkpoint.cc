@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <cstring>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "checkpoint.h"
+
+using namespace std;
+
+namespace {
+  const char kMagic[8] = {'D', 'I', 'A', 'M', 'C', 'K', 'P', '2'};
+
+  bool WriteArray(FILE *out, const vector<int> &array) {
+    return fwrite(array.data(), sizeof(int), array.size(), out) == array.size();
+  }
+
+  bool ReadArray(FILE *in, int64_t size, vector<int> &array) {
+    array.resize(size);
+    return fread(array.data(), sizeof(int), size, in) == (size_t)size;
+  }
+
+  // Every entry of array in [lo, hi]
+  bool InRange(const vector<int> &array, int64_t lo, int64_t hi) {
+    for (int x : array) {
+      if (x < lo || x > hi) return false;
+    }
+    return true;
+  }
+
+  bool IsPermutation(const vector<int> &order) {
+    vector<bool> seen(order.size(), false);
+    for (int v : order) {
+      if (v < 0 || v >= (int64_t)order.size() || seen[v]) return false;
+      seen[v] = true;
+    }
+    return true;
+  }
+} // end namespace
+
+namespace Diameter {
+  bool SaveCheckpoint(const string &filename, const Checkpoint &checkpoint) {
+    string tmp_filename = filename + ".tmp";
+    FILE *out = fopen(tmp_filename.c_str(), "wb");
+    if (out == NULL) return false;
+
+    int64_t header[5] = {checkpoint.num_vertices, checkpoint.num_edges,
+                         (int64_t)checkpoint.fingerprint, checkpoint.diameter, checkpoint.next};
+    bool ok = fwrite(kMagic, sizeof(kMagic), 1, out) == 1 &&
+              fwrite(header, sizeof(header), 1, out) == 1 &&
+              WriteArray(out, checkpoint.scc) &&
+              WriteArray(out, checkpoint.order) &&
+              WriteArray(out, checkpoint.ecc);
+    ok = fclose(out) == 0 && ok;
+    return ok && rename(tmp_filename.c_str(), filename.c_str()) == 0;
+  }
+
+  uint64_t MixEdge(uint64_t z) {
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t DepthFingerprint(const vector<int> &depth) {
+    uint64_t hash = 0;
+    for (size_t v = 0; v < depth.size(); v++) {
+      if (depth[v] > 0) hash += MixEdge(~(((uint64_t)v << 32) | (uint32_t)depth[v]));
+    }
+    return hash;
+  }
+
+  bool LoadCheckpoint(const string &filename, int64_t num_vertices, int64_t num_edges,
+                      uint64_t fingerprint, int64_t max_bound, Checkpoint &checkpoint) {
+    FILE *in = fopen(filename.c_str(), "rb");
+    if (in == NULL) return false;
+
+    char magic[sizeof(kMagic)];
+    int64_t header[5];
+    bool ok = fread(magic, sizeof(magic), 1, in) == 1 &&
+              memcmp(magic, kMagic, sizeof(kMagic)) == 0 &&
+              fread(header, sizeof(header), 1, in) == 1 &&
+              header[0] == num_vertices && header[1] == num_edges &&
+              (uint64_t)header[2] == fingerprint &&
+              header[3] >= 0 && header[3] <= max_bound &&
+              header[4] >= 0 && header[4] <= num_vertices;
+    if (ok) {
+      checkpoint.num_vertices = header[0];
+      checkpoint.num_edges = header[1];
+      checkpoint.fingerprint = header[2];
+      checkpoint.diameter = header[3];
+      checkpoint.next = header[4];
+      ok = ReadArray(in, num_vertices, checkpoint.scc) &&
+           ReadArray(in, num_vertices, checkpoint.order) &&
+           ReadArray(in, num_vertices, checkpoint.ecc);
+    }
+    fclose(in);
+    // The arrays are indexed by what they hold, and ecc bounds only fall
+    return ok && InRange(checkpoint.scc, 0, num_vertices - 1) &&
+           IsPermutation(checkpoint.order) && InRange(checkpoint.ecc, 0, max_bound);
+  }
+} // end namespace Diameter
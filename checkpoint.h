@@ -0,0 +1,48 @@
+# ifndef CHECKPOINT_H
+# define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Diameter {
+  // Progress of a fast-diameter run: everything its candidate loop needs to
+  // pick up where it stopped without redoing SCC, double sweep or BFS work.
+  struct Checkpoint {
+    int64_t num_vertices, num_edges;  // must match the graph being resumed,
+    uint64_t fingerprint;             // as must GraphFingerprint of it
+    int diameter;                     // lower bound found so far
+    int64_t next;                     // index in order of the next candidate
+    vector<int> scc, order, ecc;      // ecc holds the upper bounds
+  };
+
+  // Writes to a temporary file and renames it over filename, so a crash
+  // mid-write leaves the previous checkpoint intact.
+  bool SaveCheckpoint(const string &filename, const Checkpoint &checkpoint);
+
+  // False if there is no readable checkpoint for this graph, or the one
+  // there holds an order, SCC label, bound or position out of range.
+  // max_bound is where the run starts every eccentricity bound.
+  bool LoadCheckpoint(const string &filename, int64_t num_vertices, int64_t num_edges,
+                      uint64_t fingerprint, int64_t max_bound, Checkpoint &checkpoint);
+
+  // SplitMix64 finalizer
+  uint64_t MixEdge(uint64_t z);
+
+  // Hash of the multiset of edges, whatever order the lists hold them in
+  template <typename Lists>
+  uint64_t GraphFingerprint(const Lists &adjlist) {
+    uint64_t hash = adjlist.size();
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(+ : hash)
+    for (int64_t u = 0; u < (int64_t)adjlist.size(); u++) {
+      for (int v : adjlist[u]) hash += MixEdge(((uint64_t)u << 32) | (uint32_t)v);
+    }
+    return hash;
+  }
+
+  // Added to GraphFingerprint for a run that takes whisker depths
+  uint64_t DepthFingerprint(const vector<int> &depth);
+} // end namespace Diameter
+# endif
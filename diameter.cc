@@ -1,40 +1,258 @@
 #include <algorithm>
+#include <cstdint>
 #include <cstdlib>
-#include <deque>
+#include <limits>
+#include <numeric>
 #include <omp.h>
 #include <stack>
 #include <stdio.h>
+#include <string>
 #include <sys/time.h>
 #include <vector>
+#include "checkpoint.h"
 #include "diameter.h"
 
 namespace {
-  int BFSHeight(const vector <vector<int> > &adjlist, int source) {
-    deque<int> lineup {source};
-    vector<bool> visited(adjlist.size(), false);
-    visited[source] = true;
-    // init height to -1 since the algo counts the root as a level though it is
-    // technically at height 0.
-    int height = -1, lastInLevel = source;
-
-    while (!lineup.empty()) {
-      int curr = lineup.front();
-      lineup.pop_front();
-
-      for (int neighbor : adjlist[curr]) {
-        if (!visited[neighbor]) {
-          visited[neighbor] = true;
-          lineup.push_back(neighbor);
-        }
+  // Switching thresholds of HybridBFS. Serially a bottom-up probe costs about
+  // what a top-down edge does (no atomics either way), so it goes bottom-up
+  // a little earlier than the parallel engine and stays longer.
+  const int kSerialAlpha = 12, kSerialBeta = 24;
+
+  // Single-threaded direction-optimizing BFS. Levels are expanded top-down
+  // from the queue while the frontier is light, and bottom-up (each
+  // unvisited vertex probes its radjlist against a frontier bitmap) while
+  // the frontier holds more than 1/kSerialAlpha of the unexplored edges and
+  // is not yet shrinking below 1/kSerialBeta of the vertices. Either way
+  // reached vertices are appended to buf.queue in BFS order, so
+  // queue[count - 1] is a farthest vertex and the caller resets
+  // dist[queue[0 .. count)] afterwards. Returns count, or -1 with dist
+  // reset already if the BFS goes deeper than a Dist can count.
+  template <typename Dist>
+  int HybridBFS(const vector <vector<int> > &adjlist, const vector <vector<int> > &radjlist,
+                int64_t num_edges, int source, vector<Dist> &dist, Diameter::BFSBuffers &buf) {
+    vector<int> &queue = buf.queue;
+    vector<uint64_t> &front = buf.front;
+    const int max_depth = numeric_limits<Dist>::max();
+    int V = adjlist.size(), qs = 0, qt = 0, level = 0;
+    int64_t edges_to_check = num_edges, scout_count = adjlist[source].size();
+    bool bottom_up = false;
+    dist[source] = 0;
+    queue[qt++] = source;
+
+    while (qs < qt) {
+      if (level == max_depth) {
+        for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
+        return -1;
       }
-      if (lastInLevel == curr) {
-        height++;
-        lastInLevel = lineup.back();
+      int64_t frontier = qt - qs;
+      if (!bottom_up) {
+        bottom_up = scout_count > edges_to_check / kSerialAlpha;
+      } else {
+        bottom_up = frontier > V / kSerialBeta;
       }
+      edges_to_check -= scout_count;
+      scout_count = 0;
+      int level_end = qt;
+
+      if (bottom_up) {
+        fill(front.begin(), front.begin() + (V + 63) / 64, 0);
+        for (int j = qs; j < level_end; j++) front[queue[j] >> 6] |= uint64_t(1) << (queue[j] & 63);
+
+        for (int u = 0; u < V; u++) {
+          if (dist[u] >= 0) continue;
+          for (int v : radjlist[u]) {
+            if ((front[v >> 6] >> (v & 63)) & 1) {
+              dist[u] = Dist(level + 1);
+              queue[qt++] = u;
+              scout_count += adjlist[u].size();
+              break;
+            }
+          }
+        }
+      } else {
+        for (int j = qs; j < level_end; j++) {
+          int v = queue[j];
+
+          for (int w : adjlist[v]) {
+            if (dist[w] < 0) {
+              dist[w] = Dist(level + 1);
+              queue[qt++] = w;
+              scout_count += adjlist[w].size();
+            }
+          }
+        }
+      }
+      qs = level_end;
+      level++;
     }
+    return qt;
+  }
+
+  // Distances of the serial BFSes that only want heights, in the narrowest
+  // type every one of them has fit so far, as NarrowDistances does for the
+  // parallel engine. Past int16_t they use buf.dist.
+  struct SerialDistances {
+    int bytes;
+    vector<int8_t> d8;
+    vector<int16_t> d16;
+
+    SerialDistances() : bytes(1) {}
+  };
+
+  int Depth(const vector<int> &depth, int v) {
+    return depth.empty() ? 0 : depth[v];
+  }
+
+  // Height of a BFS that left count vertices in queue, its source first,
+  // with the whiskers of depth as in GetFastDiam: the source's own, then
+  // the farthest end of any other vertex's
+  template <typename Dist>
+  int WhiskerHeight(const vector<Dist> &dist, const vector<int> &queue, int count,
+                    const vector<int> &depth) {
+    if (depth.empty()) return dist[queue[count - 1]];
+    int reach = 0;
+    for (int j = 1; j < count; j++) reach = max(reach, dist[queue[j]] + depth[queue[j]]);
+    return depth[queue[0]] + reach;
+  }
+
+  // WhiskerHeight, resetting the count vertices afterwards
+  template <typename Dist>
+  int Height(vector<Dist> &dist, const vector<int> &queue, int count, const vector<int> &depth) {
+    int height = WhiskerHeight(dist, queue, count, depth);
+    for (int j = 0; j < count; j++) dist[queue[j]] = -1;
     return height;
   }
 
+  // Height of the BFS tree from source. A BFS too deep for its type is rerun
+  // one size up, where later ones then start.
+  int HeightBFS(const vector <vector<int> > &adjlist, const vector <vector<int> > &radjlist,
+                int64_t num_edges, int source, const vector<int> &depth,
+                SerialDistances &narrow, Diameter::BFSBuffers &buf) {
+    size_t V = adjlist.size();
+    if (narrow.bytes == 1) {
+      if (narrow.d8.size() < V) narrow.d8.assign(V, -1);
+      int count = HybridBFS(adjlist, radjlist, num_edges, source, narrow.d8, buf);
+      if (count >= 0) return Height(narrow.d8, buf.queue, count, depth);
+      narrow.bytes = 2;
+      vector<int8_t>().swap(narrow.d8);
+    }
+    if (narrow.bytes == 2) {
+      if (narrow.d16.size() < V) narrow.d16.assign(V, -1);
+      int count = HybridBFS(adjlist, radjlist, num_edges, source, narrow.d16, buf);
+      if (count >= 0) return Height(narrow.d16, buf.queue, count, depth);
+      narrow.bytes = 4;
+      vector<int16_t>().swap(narrow.d16);
+    }
+    int count = HybridBFS(adjlist, radjlist, num_edges, source, buf.dist, buf);
+    return Height(buf.dist, buf.queue, count, depth);
+  }
+
+  // One top-down BFS of InterleavedHeights, suspended between vertices
+  template <typename Dist>
+  struct BFSLane {
+    vector<Dist> dist;
+    vector<int> queue;
+    int qs, qt;
+    int v;          // vertex whose neighbors' distances are prefetched, -1 if none
+    bool overflow;  // stopped at a level a Dist can't count
+  };
+
+  template <typename Dist>
+  void StartLane(BFSLane<Dist> &lane, int source) {
+    lane.dist[source] = 0;
+    lane.queue[0] = source;
+    lane.qs = 0;
+    lane.qt = 1;
+    lane.v = -1;
+    lane.overflow = false;
+  }
+
+  // Expands the vertex prefetched last time, then takes the next one off
+  // the queue and prefetches the distances it will read, and the adjacency
+  // of the one after. Returns false once the BFS is done or has overflowed.
+  template <typename Dist>
+  bool StepLane(const vector <vector<int> > &adjlist, BFSLane<Dist> &lane) {
+    vector<Dist> &dist = lane.dist;
+    if (lane.v >= 0) {
+      int level = dist[lane.v] + 1;
+      if (level > numeric_limits<Dist>::max()) {
+        lane.overflow = true;
+        return false;
+      }
+      for (int w : adjlist[lane.v]) {
+        if (dist[w] < 0) {
+          dist[w] = Dist(level);
+          lane.queue[lane.qt++] = w;
+        }
+      }
+    }
+    if (lane.qs == lane.qt) return false;
+    lane.v = lane.queue[lane.qs++];
+    for (int w : adjlist[lane.v]) __builtin_prefetch(&dist[w]);
+    if (lane.qs < lane.qt) __builtin_prefetch(adjlist[lane.queue[lane.qs]].data());
+    return true;
+  }
+
+  // Eccentricities of sources into heights, by lanes top-down BFSes taking
+  // turns on one thread, one step each, so each lane's miss is in flight
+  // while the others run. A source too deep for Dist goes to deeper, and so
+  // does every one not started by then.
+  template <typename Dist>
+  void LaneHeights(const vector <vector<int> > &adjlist, int lanes, const vector<int> &depth,
+                   const vector<int> &sources, vector<int> &heights, vector<int> &deeper) {
+    if (sources.empty()) return;
+    int V = adjlist.size();
+    vector<BFSLane<Dist> > lane(max(1, min<int>(lanes, sources.size())));
+    vector<int> source(lane.size(), -1);
+    size_t next_source = 0;
+    bool widen = false;
+    for (size_t i = 0; i < lane.size(); i++) {
+      lane[i].dist.assign(V, -1);
+      lane[i].queue.resize(V);
+      source[i] = sources[next_source++];
+      StartLane(lane[i], source[i]);
+    }
+
+    for (size_t active = lane.size(); active > 0; ) {
+      for (size_t i = 0; i < lane.size(); i++) {
+        if (source[i] < 0 || StepLane(adjlist, lane[i])) continue;
+
+        if (lane[i].overflow) {
+          deeper.push_back(source[i]);
+          widen = true;
+        } else {
+          heights[source[i]] = WhiskerHeight(lane[i].dist, lane[i].queue, lane[i].qt, depth);
+        }
+        for (int j = 0; j < lane[i].qt; j++) lane[i].dist[lane[i].queue[j]] = -1;
+        if (!widen && next_source < sources.size()) {
+          source[i] = sources[next_source++];
+          StartLane(lane[i], source[i]);
+        } else {
+          source[i] = -1;
+          active--;
+        }
+      }
+    }
+    deeper.insert(deeper.end(), sources.begin() + next_source, sources.end());
+  }
+
+  // Eccentricity of every vertex, on int8_t distances first and wider ones
+  // for the sources those can't count
+  vector<int> InterleavedHeights(const vector <vector<int> > &adjlist, int lanes,
+                                 const vector<int> &depth) {
+    int V = adjlist.size();
+    vector<int> heights(V), sources(V), deeper;
+    iota(sources.begin(), sources.end(), 0);
+    LaneHeights<int8_t>(adjlist, lanes, depth, sources, heights, deeper);
+    sources.swap(deeper);
+    deeper.clear();
+    LaneHeights<int16_t>(adjlist, lanes, depth, sources, heights, deeper);
+    sources.swap(deeper);
+    deeper.clear();
+    LaneHeights<int>(adjlist, lanes, depth, sources, heights, deeper);
+    return heights;
+  }
+
   vector<vector<int> > Transpose(const vector <vector<int> > &adjlist) {
     vector< vector<int> > transposed(adjlist.size());
     for (size_t i = 0; i < adjlist.size(); i++) {
@@ -45,33 +263,184 @@ namespace {
     return transposed;
   }
 
-  int GetRandom(int V) {
-      static unsigned long long x = 123456789;
-      static unsigned long long y = 362436039;
-      static unsigned long long z = 521288629;
-      static unsigned long long w = 88675123;
+  uint64_t SplitMix(uint64_t &s) {
+      uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+  }
+
+  // xorshift state, owned by each run so concurrent runs don't share it
+  struct RandomState {
+      unsigned long long x = 123456789;
+      unsigned long long y = 362436039;
+      unsigned long long z = 521288629;
+      unsigned long long w = 88675123;
+
+      RandomState() {}
+
+      // Independent stream number stream of seed
+      RandomState(uint64_t seed, uint64_t stream) {
+          uint64_t s = seed ^ (stream * 0xD1B54A32D192ED03ULL);
+          x = SplitMix(s);
+          y = SplitMix(s);
+          z = SplitMix(s);
+          w = SplitMix(s);
+      }
+  };
+
+  int GetRandom(RandomState &s, int V) {
       unsigned long long t;
 
-      t = x ^ (x << 11);
-      x = y;
-      y = z;
-      z = w;
-      w = (w ^ (w >> 19)) ^ (t ^ (t >> 8));
+      t = s.x ^ (s.x << 11);
+      s.x = s.y;
+      s.y = s.z;
+      s.z = s.w;
+      s.w = (s.w ^ (s.w >> 19)) ^ (t ^ (t >> 8));
+
+      return  s.w % V;
+  }
+
+  // Where the sweeps may start: the highest-degree vertices for
+  // SWEEP_DEGREE, the largest SCC for SWEEP_SCC, anywhere if empty
+  vector<int> SweepCandidates(const vector <vector<int> > &adjlist,
+                              const vector <vector<int> > &radjlist,
+                              const vector<int> &scc, const Diameter::SweepOptions &sweeps) {
+    int V = adjlist.size();
+    vector<int> candidates;
+    if (sweeps.start == Diameter::SWEEP_DEGREE) {
+      candidates.resize(V);
+      for (int v = 0; v < V; v++) candidates[v] = v;
+      int count = min(V, max(sweeps.count, 1));
+      partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [&](int a, int b) {
+        size_t degree_a = adjlist[a].size() + radjlist[a].size();
+        size_t degree_b = adjlist[b].size() + radjlist[b].size();
+        return degree_a != degree_b ? degree_a > degree_b : a < b;
+      });
+      candidates.resize(count);
+    } else if (sweeps.start == Diameter::SWEEP_SCC) {
+      vector<int> size(V, 0);
+      for (int v = 0; v < V; v++) size[scc[v]]++;
+      int largest = max_element(size.begin(), size.end()) - size.begin();
+      for (int v = 0; v < V; v++) {
+        if (scc[v] == largest) candidates.push_back(v);
+      }
+    }
+    return candidates;
+  }
+
+  int SweepSource(const Diameter::SweepOptions &sweeps, int task,
+                  const vector<int> &candidates, int V) {
+    RandomState random(sweeps.seed, task);
+    if (candidates.empty()) return GetRandom(random, V);
+    if (sweeps.start == Diameter::SWEEP_DEGREE) return candidates[task % candidates.size()];
+    return candidates[GetRandom(random, candidates.size())];
+  }
+
+  // A double sweep from source, followed with four a second one from the
+  // middle of the path it found. Returns the best lower bound.
+  int SerialSweep(const vector <vector<int> > &adjlist, const vector <vector<int> > &radjlist,
+                  int64_t num_edges, int source, bool four, Diameter::BFSBuffers &buf) {
+    vector <int> &dist = buf.dist;
+    vector <int> &queue = buf.queue;
+    int bound = 0;
+
+    for (int round = 0; round < (four ? 2 : 1); round++) {
+      // forward BFS
+      int qt = HybridBFS(adjlist, radjlist, num_edges, source, dist, buf);
+      int start = queue[qt - 1];
+
+      for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
+
+      // backward BFS, leaving dist[v] = d(v, start)
+      qt = HybridBFS(radjlist, adjlist, num_edges, start, dist, buf);
+      int end = queue[qt - 1];
+      bound = max(bound, dist[end]);
+
+      // walk halfway down a shortest path from end to start
+      source = end;
+      for (int step = 0; step < dist[end] / 2; step++) {
+        for (int w : adjlist[source]) {
+          if (dist[w] == dist[source] - 1) {
+            source = w;
+            break;
+          }
+        }
+      }
+
+      for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
+    }
+    return bound;
+  }
+
+  // The sweeps as concurrent tasks, each thread with its own scratch (the
+  // first one borrows buf)
+  int DoubleSweeps(const vector <vector<int> > &adjlist, const vector <vector<int> > &radjlist,
+                   int64_t num_edges, const vector<int> &scc,
+                   const Diameter::SweepOptions &sweeps, Diameter::BFSBuffers &buf) {
+    int V = adjlist.size(), bound = 0;
+    vector<int> candidates = SweepCandidates(adjlist, radjlist, scc, sweeps);
 
-      return  w % V;
+    #pragma omp parallel reduction(max : bound)
+    {
+      Diameter::BFSBuffers local;
+      Diameter::BFSBuffers &mine = omp_get_thread_num() == 0 ? buf : local;
+      #pragma omp for schedule(dynamic, 1)
+      for (int task = 0; task < sweeps.count; task++) {
+        mine.Reserve(V);
+        int source = SweepSource(sweeps, task, candidates, V);
+        bound = max(bound, SerialSweep(adjlist, radjlist, num_edges, source,
+                                       sweeps.start == Diameter::SWEEP_FOUR, mine));
+      }
+    }
+    return bound;
   }
 } // end namespace
 
 namespace Diameter {
-  // Code as from @kawatea on GitHub <3
-  int GetFastDiam(const vector <vector<int> > &adjlist) {
+  bool ParseSweepStart(const string &name, SweepStart &start) {
+    if (name == "random") start = SWEEP_RANDOM;
+    else if (name == "degree") start = SWEEP_DEGREE;
+    else if (name == "four") start = SWEEP_FOUR;
+    else if (name == "scc") start = SWEEP_SCC;
+    else return false;
+    return true;
+  }
+
+  int GetFastDiam(const vector <vector<int> > &adjlist, const string &checkpoint_file,
+                  double checkpoint_interval, const SweepOptions &sweeps,
+                  const vector<int> &depth) {
+    BFSBuffers buf(adjlist.size());
+    return GetFastDiam(adjlist, buf, checkpoint_file, checkpoint_interval, sweeps, depth);
+  }
+
+  // Code as from @kawatea on GitHub <3. With whiskers, ecc[v] bounds the
+  // farthest vertex or whisker end from v, counting v's own, and v is
+  // skipped once depth[v] + ecc[v] can't beat the diameter.
+  int GetFastDiam(const vector <vector<int> > &adjlist, BFSBuffers &buf,
+                  const string &checkpoint_file, double checkpoint_interval,
+                  const SweepOptions &sweeps, const vector<int> &depth) {
     // Prepare the adjacency list
     vector <vector <int> > radjlist = Transpose(adjlist);
-    int num_double_sweep = 10, diameter = 0, V = adjlist.size();
+    int diameter = 0, V = adjlist.size();
+    // Every eccentricity bound starts here
+    int max_ecc = V + (depth.empty() ? 0 : *max_element(depth.begin(), depth.end()));
+
+    // Pick up a previous run of this graph if one left a checkpoint
+    int64_t num_edges = 0;
+    for (int v = 0; v < V; v++) num_edges += adjlist[v].size();
+    uint64_t fingerprint = checkpoint_file.empty() ? 0 :
+                           GraphFingerprint(adjlist) + DepthFingerprint(depth);
+    Checkpoint checkpoint;
+    bool resumed = !checkpoint_file.empty() &&
+                   LoadCheckpoint(checkpoint_file, V, num_edges, fingerprint, max_ecc, checkpoint);
 
     // Decompose the graph into strongly connected components
     vector <int> scc(V);
-    {
+    if (resumed) {
+        scc.swap(checkpoint.scc);
+        diameter = checkpoint.diameter;
+    } else {
         int num_visit = 0, num_scc = 0;
         vector <int> ord(V, -1);
         vector <int> low(V);
@@ -125,56 +494,18 @@ namespace Diameter {
 
     // Compute the diameter lower bound by the double sweep algorithm
     int qs, qt;
-    vector <int> dist(V, -1);
-    vector <int> queue(V);
-    {
-        for (size_t i = 0; i < num_double_sweep; i++) {
-            int start = GetRandom(V);
-
-            // forward BFS
-            qs = qt = 0;
-            dist[start] = 0;
-            queue[qt++] = start;
-
-            while (qs < qt) {
-                int v = queue[qs++];
-
-                for (size_t j = 0; j < adjlist[v].size(); j++) {
-                    if (dist[adjlist[v][j]] < 0) {
-                        dist[adjlist[v][j]] = dist[v] + 1;
-                        queue[qt++] = adjlist[v][j];
-                    }
-                }
-            }
-
-            for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
-
-            // backward BFS
-            start = queue[qt - 1];
-            qs = qt = 0;
-            dist[start] = 0;
-            queue[qt++] = start;
-
-            while (qs < qt) {
-                int v = queue[qs++];
-
-                for (size_t j = 0; j < radjlist[v].size(); j++) {
-                    if (dist[radjlist[v][j]] < 0) {
-                        dist[radjlist[v][j]] = dist[v] + 1;
-                        queue[qt++] = radjlist[v][j];
-                    }
-                }
-            }
-
-            diameter = max(diameter, dist[queue[qt - 1]]);
-
-            for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
-        }
+    buf.Reserve(V);
+    vector <int> &dist = buf.dist;
+    vector <int> &queue = buf.queue;
+    if (!resumed && V > 0) {
+        diameter = DoubleSweeps(adjlist, radjlist, num_edges, scc, sweeps, buf);
     }
 
     // Order vertices
     vector <pair<long long, int> > order(V);
-    {
+    if (resumed) {
+        for (int i = 0; i < V; i++) order[i] = make_pair(0, checkpoint.order[i]);
+    } else {
         for (int v = 0; v < V; v++) {
             size_t in = 0, out = 0;
 
@@ -186,24 +517,43 @@ namespace Diameter {
                 if (scc[adjlist[v][i]] == scc[v]) out++;
             }
 
-            // SCC : reverse topological order
-            // inside an SCC : decreasing order of the product of the indegree and outdegree for vertices in the same SCC
-            order[v] = make_pair(((long long)scc[v] << 32) - in * out, v);
+            order[v] = make_pair(-(long long)(in * out), v);
         }
 
-        sort(order.begin(), order.end());
+        // SCC : reverse topological order
+        // inside an SCC : decreasing order of the product of the indegree and outdegree for vertices in the same SCC
+        // (compared apart, the product can take all 64 bits)
+        sort(order.begin(), order.end(), [&](const pair<long long, int> &a, const pair<long long, int> &b) {
+            return scc[a.second] != scc[b.second] ? scc[a.second] < scc[b.second] : a < b;
+        });
     }
 
     // Examine every vertex
-    vector <int> ecc(V, V);
+    vector <int> ecc(V, max_ecc);
+    size_t first = 0;
+    if (resumed) {
+        ecc.swap(checkpoint.ecc);
+        first = checkpoint.next;
+    }
+    double last_save = omp_get_wtime();
+    auto save = [&](size_t next) {
+        Checkpoint progress = {V, num_edges, fingerprint, diameter, (int64_t)next, scc, vector<int>(V), ecc};
+        for (int j = 0; j < V; j++) progress.order[j] = order[j].second;
+        if (!SaveCheckpoint(checkpoint_file, progress)) {
+            fprintf(stderr, "Can't write checkpoint %s\n", checkpoint_file.c_str());
+        }
+        last_save = omp_get_wtime();
+    };
+    if (!checkpoint_file.empty() && !resumed) save(0);
     {
-        for (size_t i = 0; i < V; i++) {
+        for (size_t i = first; i < V; i++) {
             int u = order[i].second;
 
-            if (ecc[u] <= diameter) continue;
+            int own = Depth(depth, u);
+            if (own + ecc[u] <= diameter) continue;
 
             // Refine the eccentricity upper bound
-            int ub = 0;
+            int ub = own;
             vector <pair<int, int> > neighbors;
 
             for (size_t j = 0; j < adjlist[u].size(); j++) neighbors.push_back(make_pair(scc[adjlist[u][j]], ecc[adjlist[u][j]] + 1));
@@ -212,7 +562,7 @@ namespace Diameter {
 
             for (size_t j = 0; j < neighbors.size(); ) {
                 int component = neighbors[j].first;
-                int lb = V;
+                int lb = max_ecc;
 
                 for (; j < neighbors.size(); j++) {
                     if (neighbors[j].first != component) break;
@@ -221,32 +571,20 @@ namespace Diameter {
 
                 ub = max(ub, lb);
 
-                if (ub > diameter) break;
+                if (own + ub > diameter) break;
             }
 
-            if (ub <= diameter) {
+            if (own + ub <= diameter) {
                 ecc[u] = ub;
                 continue;
             }
 
             // Conduct a BFS and update bounds
-            qs = qt = 0;
-            dist[u] = 0;
-            queue[qt++] = u;
-
-            while (qs < qt) {
-                int v = queue[qs++];
-
-                for (size_t j = 0; j < adjlist[v].size(); j++) {
-                    if (dist[adjlist[v][j]] < 0) {
-                        dist[adjlist[v][j]] = dist[v] + 1;
-                        queue[qt++] = adjlist[v][j];
-                    }
-                }
-            }
+            qt = HybridBFS(adjlist, radjlist, num_edges, u, dist, buf);
 
-            ecc[u] = dist[queue[qt - 1]];
-            diameter = max(diameter, ecc[u]);
+            int height = WhiskerHeight(dist, queue, qt, depth);
+            ecc[u] = max(height - own, own);
+            diameter = max(diameter, height);
 
             for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
 
@@ -269,20 +607,37 @@ namespace Diameter {
             }
 
             for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
+
+            if (!checkpoint_file.empty() && omp_get_wtime() - last_save >= checkpoint_interval) {
+                save(i + 1);
+            }
         }
     }
+    if (!checkpoint_file.empty()) remove(checkpoint_file.c_str());
     return diameter;
   }
 
-  int GetBruteDiam(const vector <vector<int> > &adjlist) {
-    int diameter = 0;
+  int GetBruteDiam(const vector <vector<int> > &adjlist, const vector<int> &depth) {
+    int diameter = 0, V = adjlist.size();
+    vector <vector<int> > radjlist = Transpose(adjlist);
+    int64_t num_edges = 0;
+    for (int v = 0; v < V; v++) num_edges += adjlist[v].size();
+    BFSBuffers buf(V);
+    SerialDistances narrow;
 
-    for (size_t i = 0; i < adjlist.size(); i++) {
-      diameter = max(diameter, BFSHeight(adjlist, i));
+    for (int i = 0; i < V; i++) {
+      diameter = max(diameter, HeightBFS(adjlist, radjlist, num_edges, i, depth, narrow, buf));
     }
     return diameter;
   }
 
+  int GetBruteDiamInterleaved(const vector <vector<int> > &adjlist, int lanes,
+                              const vector<int> &depth) {
+    if (adjlist.empty()) return 0;
+    vector<int> heights = InterleavedHeights(adjlist, lanes, depth);
+    return *max_element(heights.begin(), heights.end());
+  }
+
   void PrintGraph(const vector <vector<int> > &adjlist) {
     for (size_t i = 0; i < adjlist.size(); i++) {
       for (int neighbor : adjlist[i]) {
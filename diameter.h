@@ -1,7 +1,9 @@
 # ifndef DIAMETER_H
 # define DIAMETER_H
 
+#include <cstdint>
 #include <cstdlib>
+#include <string>
 #include <vector>
 #include <algorithm>
 #include <sys/time.h>
@@ -9,9 +11,73 @@
 using namespace std;
 
 namespace Diameter {
-  int GetFastDiam(const vector <vector<int> > &adjlist);
+  // Where each double sweep starts:
+  //   SWEEP_RANDOM  a random vertex
+  //   SWEEP_DEGREE  the highest-degree vertices, one per sweep
+  //   SWEEP_FOUR    a random vertex, then a second double sweep from the
+  //                 middle of the path the first one found (four-sweep)
+  //   SWEEP_SCC     a random vertex of the largest SCC
+  enum SweepStart {SWEEP_RANDOM, SWEEP_DEGREE, SWEEP_FOUR, SWEEP_SCC};
 
-  int GetBruteDiam(const vector <vector<int> > &adjlist);
+  // Double sweeps that seed the diameter lower bound. They run as
+  // independent concurrent tasks, sweep i drawing from its own stream of
+  // seed, so the bound does not depend on the thread count.
+  struct SweepOptions {
+    int count;
+    SweepStart start;
+    uint64_t seed;
+  };
+
+  const SweepOptions kDefaultSweeps = {10, SWEEP_RANDOM, 88675123};
+
+  bool ParseSweepStart(const string &name, SweepStart &start);
+
+  // Scratch of the serial BFS. It only ever grows, so one instance can serve
+  // a stream of graphs of different sizes; dist is all -1 between BFSes.
+  struct BFSBuffers {
+    vector<int> dist;
+    vector<int> queue;
+    vector<uint64_t> front; // frontier bitmap of bottom-up levels
+
+    BFSBuffers() {}
+    explicit BFSBuffers(int V) { Reserve(V); }
+
+    void Reserve(int V) {
+      if ((int)dist.size() >= V) return;
+      dist.resize(V, -1);
+      queue.resize(V);
+      front.resize((V + 63) / 64);
+    }
+  };
+
+  // With a checkpoint file, progress is saved there every checkpoint_interval
+  // seconds and a run that finds one resumes from it; the file is removed
+  // once the diameter is known.
+  //
+  // A depth, if not empty, holds the attachment depth PeelWhiskers left on
+  // every vertex: v then stands for itself plus a pendant path of depth[v]
+  // more vertices, and the diameter counts their ends too, as
+  // depth[u] + d(u, v) + depth[v] for u != v. Paths between two ends at one
+  // vertex are left to the caller.
+  int GetFastDiam(const vector <vector<int> > &adjlist, const string &checkpoint_file = "",
+                  double checkpoint_interval = 600,
+                  const SweepOptions &sweeps = kDefaultSweeps,
+                  const vector<int> &depth = vector<int>());
+
+  // Same, with caller-owned scratch that is reused across calls
+  int GetFastDiam(const vector <vector<int> > &adjlist, BFSBuffers &buf,
+                  const string &checkpoint_file = "", double checkpoint_interval = 600,
+                  const SweepOptions &sweeps = kDefaultSweeps,
+                  const vector<int> &depth = vector<int>());
+
+  // depth as for GetFastDiam
+  int GetBruteDiam(const vector <vector<int> > &adjlist, const vector<int> &depth = vector<int>());
+
+  // Same, with lanes top-down BFSes interleaved on the one thread. Each
+  // lane prefetches what its next step reads and yields to the next, so
+  // lanes cache misses are in flight instead of one.
+  int GetBruteDiamInterleaved(const vector <vector<int> > &adjlist, int lanes = 8,
+                              const vector<int> &depth = vector<int>());
 
   // Debugging purposes
   void PrintGraph(const vector <vector<int> > &adjlist);
@@ -1,142 +1,632 @@
 #include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <deque>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <queue>
 #include <omp.h>
 #include <stack>
 #include <stdio.h>
+#include <string>
 #include <sys/time.h>
 #include <vector>
 #include "ForParallelFromBeamer/bitmap.h"
 #include "ForParallelFromBeamer/pvector.h"
 #include "ForParallelFromBeamer/sliding_queue.h"
+#include "checkpoint.h"
 #include "diamrallel.h"
+#include "kernels.h"
 
 using namespace std;
 
 namespace Parallel { // Collection of necessary helper functions from @sbeamer
-  // Bottom Up step in BFS from @sbeamer, variable names changed for continuity
-  int BottomUp(const pvector <pvector<int> > &radjlist, pvector<int> &distance,
-               Bitmap &queue, Bitmap &next) {
-    int awake_count = 0;
-    next.reset();
-    #pragma omp parallel for reduction(+ : awake_count) schedule(dynamic, 1024)
+  // The *Step kernels are orphaned worksharing loops: every thread of an
+  // enclosing parallel region must call them, and they return after a
+  // barrier with the team-wide count added into the shared counter. The
+  // plain kernels wrap them in a parallel region of their own.
+
+  // First vertex set in both row and bm, or -1
+  int FirstCommon(const uint64_t *row, const uint64_t *bm, int64_t num_words) {
+    for (int64_t w = 0; w < num_words; w++) {
+      uint64_t common = row[w] & bm[w];
+      if (common != 0) return w * 64 + __builtin_ctzll(common);
+    }
+    return -1;
+  }
+
+  // Bottom Up step in BFS from @sbeamer, variable names changed for continuity.
+  // next must be reset beforehand. Vertices with a row in rdense look for a
+  // parent by ANDing it with queue; reached vertices are also marked in
+  // visited if given.
+  template <typename Dist>
+  void BottomUpStep(const pvector <pvector<int> > &radjlist, pvector<Dist> &distance,
+                    const Bitmap &queue, Bitmap &next, int64_t &awake_count,
+                    const Diameter::DenseRows *rdense = NULL, Bitmap *visited = NULL) {
+    int64_t local_awake = 0;
+    #pragma omp for schedule(dynamic, 1024) nowait
     for (int u=0; u < radjlist.size(); u++) {
       if (distance[u] < 0) { // find unvisited
+        int r = rdense != NULL ? rdense->row[u] : -1;
+        if (r >= 0) {
+          int64_t num_words = rdense->words_per_row;
+          int v = FirstCommon(&rdense->bits[r * num_words], queue.words(), num_words);
+          if (v >= 0) {
+            distance[u] = distance[v] + 1;
+            local_awake++;
+            next.set_bit(u);
+            if (visited != NULL) visited->set_bit(u);
+          }
+          continue;
+        }
         for (int v : radjlist[u]) {
           if (queue.get_bit(v)) { // if parent is in the queue
             distance[u] = distance[v] + 1;
-            awake_count++;
+            local_awake++;
             next.set_bit(u);
+            if (visited != NULL) visited->set_bit(u);
             break;
           }
         }
       }
     }
-    return awake_count;
+    fetch_and_add(awake_count, local_awake);
+    #pragma omp barrier
   }
 
-  // Top Down step in BFS from @sbeamer, variable names changed for continuity
-  int TopDown(const pvector <pvector<int> > &adjlist, pvector<int> &distance,
-              SlidingQueue<int> &queue) {
-    int scout_count = 0;
+  // BottomUpStep over a segmented reverse graph. The team finishes a
+  // segment before starting the next, so together it only probes one slice
+  // of queue at a time; a vertex found through an earlier segment is
+  // skipped by the later ones. A dense row is ANDed with the slice's words
+  // (any parent will do, so words straddling it need no mask). Segments
+  // hold vertices in any chunking, so bitmaps are set atomically.
+  template <typename Dist>
+  void SegmentedBottomUpStep(const Diameter::SegmentedGraph &rsegments, pvector<Dist> &distance,
+                             const Bitmap &queue, Bitmap &next, int64_t &awake_count,
+                             const Diameter::DenseRows *rdense = NULL, Bitmap *visited = NULL) {
+    int64_t local_awake = 0;
+    int64_t num_words = rdense != NULL ? rdense->words_per_row : 0;
+    for (size_t s = 0; s < rsegments.segments.size(); s++) {
+      const Diameter::SegmentedGraph::Segment &segment = rsegments.segments[s];
+      int64_t num_vertices = segment.vertices.size();
+      int64_t first_word = s * rsegments.width / 64;
+      int64_t last_word = min(num_words, ((int64_t)s + 1) * rsegments.width / 64 + 1);
+      #pragma omp for schedule(dynamic, 1024)
+      for (int64_t i = 0; i < num_vertices; i++) {
+        int u = segment.vertices[i];
+        if (distance[u] >= 0) continue;
+        int r = rdense != NULL ? rdense->row[u] : -1;
+        int parent = -1;
+        if (r >= 0) {
+          parent = FirstCommon(&rdense->bits[r * num_words + first_word],
+                               queue.words() + first_word, last_word - first_word);
+        } else {
+          for (int64_t j = segment.offsets[i]; j < segment.offsets[i + 1]; j++) {
+            if (queue.get_bit(segment.neighbors[j])) {
+              parent = segment.neighbors[j];
+              break;
+            }
+          }
+        }
+        if (parent >= 0) {
+          if (r >= 0) parent += first_word * 64;
+          distance[u] = distance[parent] + 1;
+          local_awake++;
+          next.set_bit_atomic(u);
+          if (visited != NULL) visited->set_bit_atomic(u);
+        }
+      }
+    }
+    fetch_and_add(awake_count, local_awake);
+    #pragma omp barrier
+  }
+
+  int BottomUp(const pvector <pvector<int> > &radjlist, pvector<int> &distance,
+               Bitmap &queue, Bitmap &next) {
+    int64_t awake_count = 0;
+    next.reset();
     #pragma omp parallel
+    BottomUpStep(radjlist, distance, queue, next, awake_count);
+    return awake_count;
+  }
+
+  // Shared scratch for TopDownStep, sized for the largest frontier
+  struct FrontierPrefix {
+    pvector<int64_t> offsets;      // out-degree prefix sum over the frontier
+    pvector<int64_t> thread_sums;
+    pvector<int> dense_frontier;   // frontier vertices expanded by their rows
+    int64_t num_dense, dense_count;  // being gathered, and of this step
+
+    explicit FrontierPrefix(size_t max_frontier, size_t max_dense = 0)
+        : offsets(max_frontier + 1), thread_sums(omp_get_max_threads() + 1),
+          dense_frontier(max_dense), num_dense(0), dense_count(0) {}
+  };
+
+  // Edges per work item of TopDownStep, at least
+  const int64_t kMinEdgeChunk = 1024;
+
+  // Top Down step in BFS from @sbeamer, variable names changed for continuity.
+  // Work is split by edges rather than by frontier vertex: a prefix sum of
+  // the frontier's out-degrees maps fixed-size edge ranges back to vertices,
+  // so a hub's adjacency list is shared among threads instead of stalling
+  // one of them. Adds the number of edges leaving the new frontier to
+  // scout_count. With dense, frontier vertices that have a row there are
+  // expanded from it instead, 64 neighbors at a time against visited, which
+  // must then be given and kept up to date by every step.
+  template <typename Dist>
+  void TopDownStep(const pvector <pvector<int> > &adjlist, pvector<Dist> &distance,
+                   const SlidingQueue<int> &queue, QueueBuffer<int> &lqueue,
+                   FrontierPrefix &prefix, int64_t &scout_count,
+                   const Diameter::DenseRows *dense = NULL, Bitmap *visited = NULL) {
+    int tid = omp_get_thread_num(), num_threads = omp_get_num_threads();
+    const int *frontier = queue.begin();
+    int64_t frontier_size = queue.size();
+    int64_t *offsets = prefix.offsets.data();
+
+    // Exclusive prefix sum of degrees, one contiguous block per thread
+    int64_t lo = frontier_size * tid / num_threads;
+    int64_t hi = frontier_size * (tid + 1) / num_threads;
+    int64_t block_sum = 0;
+    for (int64_t i = lo; i < hi; i++) {
+      offsets[i] = block_sum;
+      if (dense != NULL && dense->row[frontier[i]] >= 0) {
+        prefix.dense_frontier[fetch_and_add(prefix.num_dense, 1)] = frontier[i];
+      } else {
+        block_sum += adjlist[frontier[i]].size();
+      }
+    }
+    prefix.thread_sums[tid] = block_sum;
+    #pragma omp barrier
+    #pragma omp single
     {
-      QueueBuffer<int> lqueue(queue);
-      #pragma omp for reduction(+ : scout_count)
-      for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
-        int u = *q_iter;
-        for (int v : adjlist[u]) {
-          int curr_val = distance[v];
+      prefix.dense_count = prefix.num_dense;
+      prefix.num_dense = 0;
+      int64_t total = 0;
+      for (int t = 0; t < num_threads; t++) {
+        int64_t block = prefix.thread_sums[t];
+        prefix.thread_sums[t] = total;
+        total += block;
+      }
+      offsets[frontier_size] = total;
+    }
+    for (int64_t i = lo; i < hi; i++) {
+      offsets[i] += prefix.thread_sums[tid];
+    }
+    #pragma omp barrier
+
+    int64_t total_edges = offsets[frontier_size];
+    int64_t chunk = max(kMinEdgeChunk, (total_edges + 8 * num_threads - 1) / (8 * num_threads));
+    int64_t num_chunks = (total_edges + chunk - 1) / chunk;
+    int64_t local_scout = 0;
+    #pragma omp for schedule(dynamic, 1) nowait
+    for (int64_t c = 0; c < num_chunks; c++) {
+      int64_t edge = c * chunk, edge_end = min(edge + chunk, total_edges);
+      // last frontier vertex whose edges start at or before this chunk
+      int64_t i = upper_bound(offsets, offsets + frontier_size + 1, edge) - offsets - 1;
+      for (; edge < edge_end; i++) {
+        int u = frontier[i];
+        const int *neighbors = adjlist[u].begin();
+        int64_t first = edge - offsets[i];
+        int64_t last = min(edge_end, offsets[i + 1]) - offsets[i];
+        for (int64_t j = first; j < last; j++) {
+          int v = neighbors[j];
+          Dist curr_val = distance[v];
           if (curr_val < 0) {
-            if (compare_and_swap(distance[v], curr_val, (distance[u] + 1))) {
+            if (compare_and_swap(distance[v], curr_val, Dist(distance[u] + 1))) {
+              if (visited != NULL) visited->set_bit_atomic(v);
               lqueue.push_back(v);
-              scout_count += -curr_val;
+              local_scout += adjlist[v].size();
             }
           }
         }
+        edge = offsets[i] + last;
+      }
+    }
+
+    // A row AND-NOT visited leaves just the unvisited neighbors of a word
+    int64_t num_words = dense != NULL ? dense->words_per_row : 0;
+    for (int64_t d = 0; d < prefix.dense_count; d++) {
+      int u = prefix.dense_frontier[d];
+      const uint64_t *row = &dense->bits[dense->row[u] * num_words];
+      #pragma omp for schedule(dynamic, 64) nowait
+      for (int64_t w = 0; w < num_words; w++) {
+        uint64_t fresh = row[w] & ~visited->words()[w];
+        for (; fresh != 0; fresh &= fresh - 1) {
+          int v = w * 64 + __builtin_ctzll(fresh);
+          Dist curr_val = distance[v];
+          if (curr_val < 0 && compare_and_swap(distance[v], curr_val, Dist(distance[u] + 1))) {
+            visited->set_bit_atomic(v);
+            lqueue.push_back(v);
+            local_scout += adjlist[v].size();
+          }
+        }
       }
-      lqueue.flush();
+    }
+    lqueue.flush();
+    fetch_and_add(scout_count, local_scout);
+    #pragma omp barrier
+  }
+
+  // Returns the number of edges leaving the new frontier.
+  int64_t TopDown(const pvector <pvector<int> > &adjlist, pvector<int> &distance,
+                  SlidingQueue<int> &queue) {
+    int64_t scout_count = 0;
+    FrontierPrefix prefix(queue.size());
+    #pragma omp parallel
+    {
+      QueueBuffer<int> lqueue(queue);
+      TopDownStep(adjlist, distance, queue, lqueue, prefix, scout_count);
     }
     return scout_count;
   }
 
-  void QueueToBitmap(const SlidingQueue<int> &queue, Bitmap &bm) {
-    #pragma omp parallel for
+  // Single-threaded top-down step for frontiers too small to be worth
+  // waking the team; pushes straight into the shared queue.
+  template <typename Dist>
+  int64_t SerialTopDown(const pvector <pvector<int> > &adjlist, pvector<Dist> &distance,
+                        SlidingQueue<int> &queue, Bitmap *visited = NULL) {
+    int64_t scout_count = 0;
+    for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+      int u = *q_iter;
+      for (int v : adjlist[u]) {
+        if (distance[v] < 0) {
+          distance[v] = distance[u] + 1;
+          if (visited != NULL) visited->set_bit(v);
+          queue.push_back(v);
+          scout_count += adjlist[v].size();
+        }
+      }
+    }
+    return scout_count;
+  }
+
+  void QueueToBitmapStep(const SlidingQueue<int> &queue, Bitmap &bm) {
+    #pragma omp for
     for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
       int u = *q_iter;
       bm.set_bit_atomic(u);
     }
   }
 
+  void QueueToBitmap(const SlidingQueue<int> &queue, Bitmap &bm) {
+    #pragma omp parallel
+    QueueToBitmapStep(queue, bm);
+  }
+
+  // Caller slides the window once every thread is done
+  void BitmapToQueueStep(const pvector <pvector<int> > &adjlist, const Bitmap &bm,
+                         QueueBuffer<int> &lqueue) {
+    #pragma omp for nowait
+    for (int n=0; n < adjlist.size(); n++)
+      if (bm.get_bit(n))
+        lqueue.push_back(n);
+    lqueue.flush();
+    #pragma omp barrier
+  }
+
   void BitmapToQueue(const pvector <pvector<int> > &adjlist, const Bitmap &bm,
                      SlidingQueue<int> &queue) {
     #pragma omp parallel
     {
       QueueBuffer<int> lqueue(queue);
-      #pragma omp for
-      for (int n=0; n < adjlist.size(); n++)
-        if (bm.get_bit(n))
-          lqueue.push_back(n);
-      lqueue.flush();
+      BitmapToQueueStep(adjlist, bm, lqueue);
     }
     queue.slide_window();
   }
 } // end namespace parallel
 
 namespace {
-  int NumEdges(const pvector <pvector<int> > &adjlist) {
-    int count = 0;
+  int64_t NumEdges(const pvector <pvector<int> > &adjlist) {
+    int64_t count = 0;
+    #pragma omp parallel for reduction(+ : count)
     for (size_t i = 0; i < adjlist.size(); i++) {
       count += adjlist[i].size();
     }
     return count;
   }
 
+  // Below these a level runs on one thread; forking the team costs more
+  const size_t kSerialFrontier = 1024;
+  const int64_t kSerialScout = 16384;
+
+  bool SmallFrontier(const SlidingQueue<int> &queue, int64_t scout_count) {
+    return queue.size() < kSerialFrontier && scout_count < kSerialScout;
+  }
+
+  // What the team does for one BFS level, decided by a single thread
+  enum LevelStep {STEP_DONE, STEP_SERIAL, STEP_TOP_DOWN, STEP_TO_BITMAP,
+                  STEP_BOTTOM_UP, STEP_TO_QUEUE};
+
+  // Direction-optimizing BFS from source, leaving every vertex's distance
+  // (-1 if unreachable) in distance, which must hold V entries. Returns the
+  // height of the BFS tree and a vertex at that depth, or (-1, -1) if the
+  // tree is deeper than a Dist can count. The steps use whatever layout
+  // offers for this direction.
+  template <typename Dist>
+  pair<int,int> BFSParallel(const pvector <pvector<int> > &adjlist,
+                            const pvector <pvector<int> > &radjlist,
+                            int source, Diameter::DirectionParams params,
+                            pvector<Dist> &distance,
+                            const Diameter::BFSLayout *layout = NULL) {
+    int alpha = params.alpha, beta = params.beta;
+    int64_t V = adjlist.size();
+    // depth is that of the frontier; a step that would pass max_depth
+    // ends the BFS as overflowed instead
+    const int max_depth = numeric_limits<Dist>::max();
+    int depth = 0;
+    bool overflow = false;
+    const Diameter::DenseRows *dense = layout != NULL ? layout->dense : NULL;
+    const Diameter::DenseRows *rdense = layout != NULL ? layout->rdense : NULL;
+    const Diameter::SegmentedGraph *rsegments = layout != NULL ? layout->rsegments : NULL;
+
+    distance.fill(-1);
+    distance[source] = 0;
+    // Only dense rows read it
+    Bitmap visited_bits(dense != NULL ? V : 0);
+    Bitmap *visited = NULL;
+    if (dense != NULL) {
+      visited = &visited_bits;
+      visited->reset();
+      visited->set_bit(source);
+    }
+    SlidingQueue<int> queue(adjlist.size());
+    queue.push_back(source);
+    queue.slide_window();
+    int64_t edges_to_check = NumEdges(adjlist);
+    int64_t scout_count = adjlist[source].size();
+
+    // High-diameter graphs may never leave this loop, and never fork
+    while (!queue.empty() && depth < max_depth && SmallFrontier(queue, scout_count) &&
+           !(scout_count > edges_to_check / alpha)) {
+      depth++;
+      edges_to_check -= scout_count;
+      scout_count = Parallel::SerialTopDown(adjlist, distance, queue, visited);
+      queue.slide_window();
+    }
+
+    if (!queue.empty()) {
+      Bitmap curr(adjlist.size());
+      Bitmap front(adjlist.size());
+      int64_t awake_count = 0, old_awake_count = 0;
+      // Indexed by level parity: a slow thread may still be reading one
+      // level's step while the single of the next level writes the other.
+      LevelStep step[2];
+      int64_t counter[2];
+      bool bottom_up = false;
+      Parallel::FrontierPrefix prefix(adjlist.size(),
+                                      dense != NULL ? dense->bits.size() / dense->words_per_row : 0);
+
+      #pragma omp parallel
+      {
+        QueueBuffer<int> lqueue(queue);
+        for (int level = 0; ; level++) {
+          int p = level & 1;
+          #pragma omp single
+          {
+            // Finish the previous level
+            switch (level == 0 ? STEP_DONE : step[!p]) {
+              case STEP_TOP_DOWN:
+                scout_count = counter[!p];
+                queue.slide_window();
+                break;
+              case STEP_TO_BITMAP:
+                awake_count = queue.size();
+                queue.slide_window();
+                bottom_up = true;
+                break;
+              case STEP_BOTTOM_UP:
+                old_awake_count = awake_count;
+                awake_count = counter[!p];
+                front.swap(curr);
+                break;
+              case STEP_TO_QUEUE:
+                queue.slide_window();
+                scout_count = 1;
+                bottom_up = false;
+                break;
+              default:
+                break;
+            }
+
+            // Pick this level's step
+            counter[p] = 0;
+            if (bottom_up) {
+              if (step[!p] == STEP_TO_BITMAP || awake_count >= old_awake_count ||
+                  awake_count > V / beta) {
+                step[p] = STEP_BOTTOM_UP;
+                curr.reset();
+              } else {
+                step[p] = STEP_TO_QUEUE;
+              }
+            } else if (queue.empty()) {
+              step[p] = STEP_DONE;
+            } else if (scout_count > edges_to_check / alpha) {
+              step[p] = STEP_TO_BITMAP;
+              front.reset();
+            } else if (SmallFrontier(queue, scout_count)) {
+              step[p] = STEP_SERIAL;
+            } else {
+              step[p] = STEP_TOP_DOWN;
+            }
+
+            // The conversions stay at one depth; the rest go one deeper
+            if (step[p] == STEP_SERIAL || step[p] == STEP_TOP_DOWN ||
+                step[p] == STEP_BOTTOM_UP) {
+              if (depth == max_depth) {
+                step[p] = STEP_DONE;
+                overflow = true;
+              } else {
+                depth++;
+                if (step[p] != STEP_BOTTOM_UP) edges_to_check -= scout_count;
+              }
+            }
+            if (step[p] == STEP_SERIAL) {
+              scout_count = Parallel::SerialTopDown(adjlist, distance, queue, visited);
+              queue.slide_window();
+            }
+          }
+
+          LevelStep my_step = step[p];
+          if (my_step == STEP_DONE) break;
+          switch (my_step) {
+            case STEP_TOP_DOWN:
+              Parallel::TopDownStep(adjlist, distance, queue, lqueue, prefix, counter[p],
+                                    dense, visited);
+              break;
+            case STEP_TO_BITMAP:
+              Parallel::QueueToBitmapStep(queue, front);
+              break;
+            case STEP_BOTTOM_UP:
+              if (rsegments != NULL) {
+                Parallel::SegmentedBottomUpStep(*rsegments, distance, front, curr, counter[p],
+                                                rdense, visited);
+              } else {
+                Parallel::BottomUpStep(radjlist, distance, front, curr, counter[p], rdense,
+                                       visited);
+              }
+              break;
+            case STEP_TO_QUEUE:
+              Parallel::BitmapToQueueStep(adjlist, front, lqueue);
+              break;
+            default:
+              break;
+          }
+        }
+      }
+    }
+
+    if (overflow) return make_pair(-1, -1);
+    int dist = 0, last_node = source;
+    for (int n = 0; n < distance.size(); n++) {
+      if (distance[n] > dist) {
+        last_node = n;
+        dist = distance[n];
+      }
+    }
+    return make_pair(dist, last_node);
+  }
+
+  // Distance arrays for BFSes that only want heights, in the narrowest type
+  // every one of them has fit so far: int8_t counts 127 levels and int16_t
+  // 32767, for a quarter or half of the memory traffic. A BFS too deep for
+  // its type is rerun one size up, where later ones then start.
+  struct NarrowDistances {
+    int bytes;
+    pvector<int8_t> d8;
+    pvector<int16_t> d16;
+    pvector<int> d32;
+
+    explicit NarrowDistances(int start_bytes = 1) : bytes(start_bytes) {}
+  };
+
+  template <typename Dist>
+  pvector<Dist> &Sized(pvector<Dist> &distance, size_t V) {
+    if (distance.size() != V) distance = pvector<Dist>(V);
+    return distance;
+  }
+
   pair<int,int> BFSHeightParallel(const pvector <pvector<int> > &adjlist,
                                   const pvector <pvector<int> > &radjlist,
-                                  int source) {
-    int alpha = 15, beta = 18;
+                                  int source, Diameter::DirectionParams params,
+                                  NarrowDistances &narrow,
+                                  const Diameter::BFSLayout *layout = NULL) {
+    size_t V = adjlist.size();
+    if (narrow.bytes == 1) {
+      pair<int,int> height = BFSParallel(adjlist, radjlist, source, params,
+                                         Sized(narrow.d8, V), layout);
+      if (height.first >= 0) return height;
+      narrow.bytes = 2;
+      narrow.d8 = pvector<int8_t>();
+    }
+    if (narrow.bytes == 2) {
+      pair<int,int> height = BFSParallel(adjlist, radjlist, source, params,
+                                         Sized(narrow.d16, V), layout);
+      if (height.first >= 0) return height;
+      narrow.bytes = 4;
+      narrow.d16 = pvector<int16_t>();
+    }
+    return BFSParallel(adjlist, radjlist, source, params, Sized(narrow.d32, V), layout);
+  }
 
+  // Cost of every level of one BFS when run purely top-down and purely
+  // bottom-up. The level sets are the same either way, so the hybrid BFS
+  // with any thresholds can be replayed from these numbers.
+  struct LevelCosts {
+    vector<int64_t> frontier;    // vertices in the frontier of each level
+    vector<int64_t> scout;       // edges leaving the frontier of each level
+    vector<double> top_down;     // seconds to expand the level top-down
+    vector<double> bottom_up;    // seconds to expand it bottom-up, -1 if unmeasured
+  };
+
+  LevelCosts MeasureLevels(const pvector <pvector<int> > &adjlist,
+                           const pvector <pvector<int> > &radjlist, int source) {
+    LevelCosts costs;
     pvector<int> distance(adjlist.size(), -1);
     distance[source] = 0;
     SlidingQueue<int> queue(adjlist.size());
     queue.push_back(source);
     queue.slide_window();
-    Bitmap curr(adjlist.size());
-    curr.reset();
+    int64_t scout_count = adjlist[source].size();
+    double total_top_down = 0;
+    while (!queue.empty()) {
+      costs.frontier.push_back(queue.size());
+      costs.scout.push_back(scout_count);
+      double start = omp_get_wtime();
+      scout_count = Parallel::TopDown(adjlist, distance, queue);
+      queue.slide_window();
+      costs.top_down.push_back(omp_get_wtime() - start);
+      total_top_down += costs.top_down.back();
+    }
+
+    // Pure bottom-up costs V work per level, so stop timing once it has
+    // clearly lost (e.g. on long paths); unmeasured levels stay top-down.
+    costs.bottom_up.assign(costs.frontier.size(), -1);
+    distance.fill(-1);
+    distance[source] = 0;
     Bitmap front(adjlist.size());
     front.reset();
-    int edges_to_check = NumEdges(adjlist);
-    int scout_count = adjlist[source].size();
-    while (!queue.empty()) {
+    front.set_bit(source);
+    Bitmap curr(adjlist.size());
+    double total_bottom_up = 0;
+    for (size_t level = 0; level < costs.frontier.size(); level++) {
+      double start = omp_get_wtime();
+      Parallel::BottomUp(radjlist, distance, front, curr);
+      front.swap(curr);
+      costs.bottom_up[level] = omp_get_wtime() - start;
+      total_bottom_up += costs.bottom_up[level];
+      if (total_bottom_up > 2 * total_top_down) break;
+    }
+    return costs;
+  }
+
+  // Replays the switching rule of BFSHeightParallel over measured levels
+  double SimulateHybrid(const LevelCosts &costs, int64_t num_edges, int64_t V,
+                        int alpha, int beta) {
+    const double kUnmeasured = 1e30;
+    size_t num_levels = costs.frontier.size(), level = 0;
+    int64_t edges_to_check = num_edges, scout_count = costs.scout[0];
+    double total = 0;
+    while (level < num_levels) {
       if (scout_count > edges_to_check / alpha) {
-        int awake_count, old_awake_count;
-        Parallel::QueueToBitmap(queue, front);
-        awake_count = queue.size();
-        queue.slide_window();
+        int64_t awake_count = costs.frontier[level], old_awake_count;
         do {
           old_awake_count = awake_count;
-          awake_count = Parallel::BottomUp(radjlist, distance, front, curr);
-          front.swap(curr);
-        } while ((awake_count >= old_awake_count) ||
-                 (awake_count > adjlist.size() / beta));
-        Parallel::BitmapToQueue(adjlist, front, queue);
+          double step = costs.bottom_up[level];
+          total += step < 0 ? kUnmeasured : step;
+          level++;
+          awake_count = level < num_levels ? costs.frontier[level] : 0;
+        } while ((awake_count >= old_awake_count && awake_count > 0) ||
+                 (awake_count > V / beta));
         scout_count = 1;
       } else {
         edges_to_check -= scout_count;
-        scout_count = Parallel::TopDown(adjlist, distance, queue);
-        queue.slide_window();
+        total += costs.top_down[level];
+        level++;
+        scout_count = level < num_levels ? costs.scout[level] : 0;
       }
     }
-    int dist = 0, last_node = 0;
-    for (int n = 0; n < distance.size(); n++) {
-      dist = max(dist, distance[n]);
-      if (distance[n] > dist) {
-        last_node = n;
-        dist = distance[n];
-      }
-    }
-    return make_pair(dist, last_node);
+    return total;
   }
 
   pvector<pvector<int> > Transpose(const pvector <pvector<int> > &adjlist) {
@@ -149,46 +639,95 @@ namespace {
     return transposed;
   }
 
-  int GetRandom(int V) {
-      static unsigned long long x = 123456789;
-      static unsigned long long y = 362436039;
-      static unsigned long long z = 521288629;
-      static unsigned long long w = 88675123;
+  uint64_t SplitMix(uint64_t &s) {
+      uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+  }
+
+  // xorshift state, owned by each run so concurrent runs don't share it
+  struct RandomState {
+      unsigned long long x = 123456789;
+      unsigned long long y = 362436039;
+      unsigned long long z = 521288629;
+      unsigned long long w = 88675123;
+
+      RandomState() {}
+
+      // Independent stream number stream of seed
+      RandomState(uint64_t seed, uint64_t stream) {
+          uint64_t s = seed ^ (stream * 0xD1B54A32D192ED03ULL);
+          x = SplitMix(s);
+          y = SplitMix(s);
+          z = SplitMix(s);
+          w = SplitMix(s);
+      }
+  };
+
+  int GetRandom(RandomState &s, int V) {
       unsigned long long t;
 
-      t = x ^ (x << 11);
-      x = y;
-      y = z;
-      z = w;
-      w = (w ^ (w >> 19)) ^ (t ^ (t >> 8));
+      t = s.x ^ (s.x << 11);
+      s.x = s.y;
+      s.y = s.z;
+      s.z = s.w;
+      s.w = (s.w ^ (s.w >> 19)) ^ (t ^ (t >> 8));
 
-      return  w % V;
+      return  s.w % V;
   }
-} // end namespace
 
-namespace Diameter{
-  pvector <pvector<int> > BuildTSGraph(const vector <pair<int, int> > &edges) {
-    int max_node = 0;
-    for (pair<int, int> edge : edges) {
-      max_node = max({max_node, edge.first + 1, edge.second + 1});
+  // Graphs this small finish a BFS faster than the timings can resolve
+  const int kMinTuneVertices = 1 << 14;
+  const int kNumTuneSamples = 4;
+
+  // Calibration pass: measure both step kinds on a few sampled sources and
+  // keep the thresholds whose replayed hybrid BFS would have been cheapest.
+  Diameter::DirectionParams TuneDirection(const pvector <pvector<int> > &adjlist,
+                                          const pvector <pvector<int> > &radjlist) {
+    const int alphas[] = {1, 2, 4, 8, 15, 30, 60, 125, 250, 500, 1000, 4000, 16000};
+    const int betas[] = {2, 4, 8, 18, 36, 72, 144, 288, 576, 2048};
+    int V = adjlist.size();
+    if (V < kMinTuneVertices) return Diameter::kDefaultDirection;
+
+    vector<LevelCosts> samples;
+    RandomState random;
+    for (int i = 0, attempts = 0; i < kNumTuneSamples && attempts < 16 * kNumTuneSamples; attempts++) {
+      int source = GetRandom(random, V);
+      if (adjlist[source].size() == 0) continue;
+      samples.push_back(MeasureLevels(adjlist, radjlist, source));
+      i++;
     }
-    pvector <pvector<int> > adjlist(max_node);
+    if (samples.empty()) return Diameter::kDefaultDirection;
 
-    for (pair<int, int> edge : edges) {
-      adjlist[edge.first].push_back(edge.second);
+    int64_t num_edges = NumEdges(adjlist);
+    Diameter::DirectionParams best = Diameter::kDefaultDirection;
+    double best_cost = 0;
+    for (const LevelCosts &costs : samples) {
+      best_cost += SimulateHybrid(costs, num_edges, V, best.alpha, best.beta);
     }
-    return adjlist;
+    for (int alpha : alphas) {
+      for (int beta : betas) {
+        double cost = 0;
+        for (const LevelCosts &costs : samples) {
+          cost += SimulateHybrid(costs, num_edges, V, alpha, beta);
+        }
+        if (cost < best_cost) {
+          best_cost = cost;
+          best.alpha = alpha;
+          best.beta = beta;
+        }
+      }
+    }
+    return best;
   }
 
-  int GetFastDiamParallel(const pvector <pvector<int> > &adjlist) {
-    // Prepare the adjacency list
-    pvector <pvector <int> > radjlist = Transpose(adjlist);
-    int num_double_sweep = 10, diameter = 0, V = adjlist.size();
-
-    // Decompose the graph into strongly connected components
-    pvector <int> scc(V);
+  // Tarjan's algorithm; labels come out in reverse topological order of the
+  // condensation. Returns the number of components.
+  int DecomposeSCC(const pvector <pvector<int> > &adjlist, pvector<int> &scc) {
+    int V = adjlist.size(), num_scc = 0;
     {
-        int num_visit = 0, num_scc = 0;
+        int num_visit = 0;
         pvector <int> ord(V, -1);
         pvector <int> low(V);
         pvector <bool> in(V, false);
@@ -238,59 +777,785 @@ namespace Diameter{
             }
         }
     }
+    return num_scc;
+  }
+
+  // Stable LSD radix sort of values by keys, 8 bits a pass, in parallel:
+  // every thread counts the digits of a fixed block, a prefix sum over
+  // (digit, thread) gives each its slots, and the block is scattered in
+  // order. Digits that every key shares are skipped.
+  void ParallelRadixSort(pvector<uint64_t> &keys, pvector<int> &values) {
+    const int kRadixBits = 8, kBuckets = 1 << kRadixBits;
+    int64_t n = keys.size();
+    uint64_t any_set = 0, all_set = ~uint64_t(0);
+    #pragma omp parallel for reduction(| : any_set) reduction(& : all_set)
+    for (int64_t i = 0; i < n; i++) {
+      any_set |= keys[i];
+      all_set &= keys[i];
+    }
+    uint64_t varying = any_set ^ all_set;
 
-    // Compute the diameter lower bound by the double sweep algorithm
-    {
-        for (size_t i = 0; i < num_double_sweep; i++) {
-            int start = GetRandom(V);
+    pvector<uint64_t> keys_out(n);
+    pvector<int> values_out(n);
+    vector<int64_t> counts((size_t)omp_get_max_threads() * kBuckets);
+    for (int shift = 0; shift < 64; shift += kRadixBits) {
+      if (((varying >> shift) & (kBuckets - 1)) == 0) continue;
+
+      #pragma omp parallel
+      {
+        int t = omp_get_thread_num(), num_threads = omp_get_num_threads();
+        int64_t begin = n * t / num_threads, end = n * (t + 1) / num_threads;
+        int64_t *count = &counts[(size_t)t * kBuckets];
+        fill(count, count + kBuckets, 0);
+        for (int64_t i = begin; i < end; i++) count[(keys[i] >> shift) & (kBuckets - 1)]++;
+        #pragma omp barrier
+
+        #pragma omp single
+        {
+          int64_t total = 0;
+          for (int digit = 0; digit < kBuckets; digit++) {
+            for (int u = 0; u < num_threads; u++) {
+              int64_t c = counts[(size_t)u * kBuckets + digit];
+              counts[(size_t)u * kBuckets + digit] = total;
+              total += c;
+            }
+          }
+        }
+
+        for (int64_t i = begin; i < end; i++) {
+          int64_t slot = count[(keys[i] >> shift) & (kBuckets - 1)]++;
+          keys_out[slot] = keys[i];
+          values_out[slot] = values[i];
+        }
+      }
+      keys.swap(keys_out);
+      values.swap(values_out);
+    }
+  }
+
+  // SCC : reverse topological order
+  // inside an SCC : decreasing order of the product of the indegree and outdegree for vertices in the same SCC
+  pvector<int> OrderVertices(const pvector <pvector<int> > &adjlist,
+                             const pvector <pvector<int> > &radjlist,
+                             const pvector<int> &scc) {
+    int V = adjlist.size();
+    pvector<uint64_t> keys(V);
+    pvector<int> vertices(V);
 
-            // forward BFS
-            pair<int,int> dist_node = BFSHeightParallel(adjlist, radjlist, start);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int v = 0; v < V; v++) {
+        uint64_t in = 0, out = 0;
 
-            // backward BFS
-            start = dist_node.second;
-            diameter = dist_node.first;
+        for (size_t i = 0; i < radjlist[v].size(); i++) {
+            if (scc[radjlist[v][i]] == scc[v]) in++;
+        }
 
-            diameter = max(diameter, BFSHeightParallel(radjlist, adjlist, start).first);
+        for (size_t i = 0; i < adjlist[v].size(); i++) {
+            if (scc[adjlist[v][i]] == scc[v]) out++;
         }
+
+        // decreasing in * out, which can take all 64 bits
+        keys[v] = ~(in * out);
+        vertices[v] = v;
+    }
+
+    // Sort by the product, then stably by SCC, which keeps the product
+    // order (and ties by vertex ID) inside every SCC
+    ParallelRadixSort(keys, vertices);
+    #pragma omp parallel for
+    for (int i = 0; i < V; i++) keys[i] = scc[vertices[i]];
+    ParallelRadixSort(keys, vertices);
+    return vertices;
+  }
+
+  // Height of the BFS from source with whisker depths, as GetFastDiam
+  // counts them, given the distances it left
+  template <typename Dist>
+  int WhiskerHeight(const pvector<Dist> &distance, int source, const vector<int> &depth) {
+    int reach = 0;
+    #pragma omp parallel for reduction(max : reach)
+    for (int64_t v = 0; v < (int64_t)distance.size(); v++) {
+      if (v != source && distance[v] >= 0) reach = max(reach, distance[v] + depth[v]);
     }
+    return depth[source] + reach;
+  }
+
+  // Same, over whichever array of narrow its last BFS used
+  int WhiskerHeight(NarrowDistances &narrow, int source, const vector<int> &depth) {
+    if (narrow.bytes == 1) return WhiskerHeight(narrow.d8, source, depth);
+    if (narrow.bytes == 2) return WhiskerHeight(narrow.d16, source, depth);
+    return WhiskerHeight(narrow.d32, source, depth);
+  }
+
+  // Queue BFS for one thread; dist must be all -1 and is left that way.
+  // Counts whiskers if depth isn't empty.
+  int SerialBFSHeight(const pvector <pvector<int> > &adjlist, int source,
+                      const vector<int> &depth, pvector<int> &dist, pvector<int> &queue) {
+    int qs = 0, qt = 0;
+    dist[source] = 0;
+    queue[qt++] = source;
+
+    while (qs < qt) {
+      int v = queue[qs++];
 
-    // Order vertices
-    pvector <pair<long long, int> > order(V);
+      for (int w : adjlist[v]) {
+        if (dist[w] < 0) {
+          dist[w] = dist[v] + 1;
+          queue[qt++] = w;
+        }
+      }
+    }
+
+    int height = dist[queue[qt - 1]];
+    if (!depth.empty()) {
+      int reach = 0;
+      for (int j = 1; j < qt; j++) reach = max(reach, dist[queue[j]] + depth[queue[j]]);
+      height = depth[source] + reach;
+    }
+    for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
+    return height;
+  }
+
+  // Queue BFS from source through SCC c only; returns how many vertices
+  // it queued, leaving their distances in dist for the caller to reset
+  int ComponentBFS(const pvector <pvector<int> > &adjlist, const pvector<int> &scc, int c,
+                   int source, pvector<int> &dist, pvector<int> &queue) {
+    int qs = 0, qt = 0;
+    dist[source] = 0;
+    queue[qt++] = source;
+    while (qs < qt) {
+      int v = queue[qs++];
+      for (int w : adjlist[v]) {
+        if (dist[w] < 0 && scc[w] == c) {
+          dist[w] = dist[v] + 1;
+          queue[qt++] = w;
+        }
+      }
+    }
+    return qt;
+  }
+
+  // The bounding loop over the count members of SCC c (in examination
+  // order) for one thread, seeded by double sweeps like GetDiameter. Paths
+  // between members never leave the SCC, so every BFS is restricted to it.
+  // ecc holds the members' upper bounds, V to start with; dist must be all
+  // -1 and is left that way.
+  int SerialComponentDiameter(const pvector <pvector<int> > &adjlist,
+                              const pvector <pvector<int> > &radjlist, const pvector<int> &scc,
+                              int c, const int *members, int count,
+                              const Diameter::SweepOptions &sweeps, pvector<int> &ecc,
+                              pvector<int> &dist, pvector<int> &queue) {
+    int diameter = 0;
+    for (int task = 0; task < sweeps.count; task++) {
+      RandomState random(sweeps.seed, task);
+      int source = members[GetRandom(random, count)];
+      for (int pass = 0; pass < 2; pass++) {
+        int qt = ComponentBFS(pass == 0 ? adjlist : radjlist, scc, c, source, dist, queue);
+        source = queue[qt - 1];
+        diameter = max(diameter, dist[source]);
+        for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
+      }
+    }
+
+    for (int i = 0; i < count; i++) {
+      int u = members[i];
+      if (ecc[u] <= diameter) continue;
+
+      int ub = ecc[u];
+      for (int w : adjlist[u]) {
+        if (scc[w] == c) ub = min(ub, ecc[w] + 1);
+      }
+      if (ub <= diameter) {
+        ecc[u] = ub;
+        continue;
+      }
+
+      int qt = ComponentBFS(adjlist, scc, c, u, dist, queue);
+      ecc[u] = dist[queue[qt - 1]];
+      diameter = max(diameter, ecc[u]);
+      for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
+
+      qt = ComponentBFS(radjlist, scc, c, u, dist, queue);
+      for (int j = 0; j < qt; j++) {
+        int v = queue[j];
+        ecc[v] = min(ecc[v], dist[v] + ecc[u]);
+        dist[v] = -1;
+      }
+    }
+    return diameter;
+  }
+
+  // SCCs at least this big, and holding at least 1/threads of the graph,
+  // get the whole team in GetComponentDiameters
+  const int kMinParallelComponent = 1 << 14;
+
+  // Per-BFS state every concurrent BFS of the brute force may hold, in total
+  const int64_t kBruteWorkspaceBudget = int64_t(1) << 32;
+
+  // Threads cooperating on each BFS of the brute force. One thread per BFS
+  // has no synchronization at all, so it wins whenever every thread can
+  // afford its own distance and queue arrays; past that budget the team
+  // splits into as many groups as fit, each running the parallel BFS.
+  int BruteGroupWidth(int64_t V, int num_threads) {
+    // arrays plus two bitmaps; an empty graph still fits one group per thread
+    int64_t per_bfs = max<int64_t>(1, 2 * sizeof(int) * V + V / 4);
+    int64_t groups = max<int64_t>(1, min<int64_t>(num_threads, kBruteWorkspaceBudget / per_bfs));
+    while (num_threads % groups != 0) groups--;
+    return num_threads / groups;
+  }
+
+  // Where the sweeps may start: the highest-degree vertices for
+  // SWEEP_DEGREE, the largest SCC for SWEEP_SCC, anywhere if empty
+  vector<int> SweepCandidates(const pvector <pvector<int> > &adjlist,
+                              const pvector <pvector<int> > &radjlist,
+                              const pvector<int> &scc, const Diameter::SweepOptions &sweeps) {
+    int V = adjlist.size();
+    vector<int> candidates;
+    if (sweeps.start == Diameter::SWEEP_DEGREE) {
+      candidates.resize(V);
+      #pragma omp parallel for
+      for (int v = 0; v < V; v++) candidates[v] = v;
+      int count = min(V, max(sweeps.count, 1));
+      partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [&](int a, int b) {
+        size_t degree_a = adjlist[a].size() + radjlist[a].size();
+        size_t degree_b = adjlist[b].size() + radjlist[b].size();
+        return degree_a != degree_b ? degree_a > degree_b : a < b;
+      });
+      candidates.resize(count);
+    } else if (sweeps.start == Diameter::SWEEP_SCC) {
+      pvector<int> size(V, 0);
+      #pragma omp parallel for
+      for (int v = 0; v < V; v++) fetch_and_add(size[scc[v]], 1);
+      int largest = max_element(size.begin(), size.end()) - size.begin();
+      for (int v = 0; v < V; v++) {
+        if (scc[v] == largest) candidates.push_back(v);
+      }
+    }
+    return candidates;
+  }
+
+  int SweepSource(const Diameter::SweepOptions &sweeps, int task,
+                  const vector<int> &candidates, int V) {
+    RandomState random(sweeps.seed, task);
+    if (candidates.empty()) return GetRandom(random, V);
+    if (sweeps.start == Diameter::SWEEP_DEGREE) return candidates[task % candidates.size()];
+    return candidates[GetRandom(random, candidates.size())];
+  }
+
+  // Cuts radjlist into segments of neighbors width vertex IDs wide, one
+  // counting pass and one copying pass over the edges per segment
+  Diameter::SegmentedGraph SegmentGraph(const pvector <pvector<int> > &radjlist, int64_t width) {
+    Diameter::SegmentedGraph segmented;
+    segmented.width = width;
+    int64_t V = radjlist.size();
+    segmented.segments.resize((V + width - 1) / width);
+    pvector<int64_t> degree(V);
+    for (size_t s = 0; s < segmented.segments.size(); s++) {
+      Diameter::SegmentedGraph::Segment &segment = segmented.segments[s];
+      int64_t lo = s * width, hi = min(V, lo + width);
+      #pragma omp parallel for schedule(dynamic, 1024)
+      for (int64_t u = 0; u < V; u++) {
+        int64_t count = 0;
+        for (int v : radjlist[u]) count += (v >= lo && v < hi);
+        degree[u] = count;
+      }
+
+      int64_t num_vertices = 0, num_neighbors = 0;
+      for (int64_t u = 0; u < V; u++) {
+        num_vertices += degree[u] > 0;
+        num_neighbors += degree[u];
+      }
+      segment.vertices = pvector<int>(num_vertices);
+      segment.offsets = pvector<int64_t>(num_vertices + 1);
+      segment.neighbors = pvector<int>(num_neighbors);
+      for (int64_t u = 0, i = 0, offset = 0; u < V; u++) {
+        if (degree[u] == 0) continue;
+        segment.vertices[i] = u;
+        segment.offsets[i++] = offset;
+        offset += degree[u];
+      }
+      segment.offsets[num_vertices] = num_neighbors;
+
+      #pragma omp parallel for schedule(dynamic, 1024)
+      for (int64_t i = 0; i < num_vertices; i++) {
+        int64_t j = segment.offsets[i];
+        for (int v : radjlist[segment.vertices[i]]) {
+          if (v >= lo && v < hi) segment.neighbors[j++] = v;
+        }
+      }
+    }
+    return segmented;
+  }
+
+  // Rows of the vertices dense enough for one; none at all leaves
+  // words_per_row 0 and nothing allocated
+  Diameter::DenseRows BuildDenseRows(const pvector <pvector<int> > &adjlist) {
+    Diameter::DenseRows dense;
+    dense.words_per_row = 0;
+    int64_t V = adjlist.size();
+    size_t threshold = max<int64_t>(1, V / Diameter::kDenseRowDivisor);
+    int num_rows = 0;
+    for (int64_t v = 0; v < V; v++) num_rows += adjlist[v].size() >= threshold;
+    if (num_rows == 0) return dense;
+
+    dense.words_per_row = (V + 63) / 64;
+    dense.row = pvector<int>(V);
+    for (int64_t v = 0, r = 0; v < V; v++) {
+      dense.row[v] = adjlist[v].size() >= threshold ? r++ : -1;
+    }
+    dense.bits = pvector<uint64_t>(num_rows * dense.words_per_row);
+    dense.bits.fill(0);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t v = 0; v < V; v++) {
+      if (dense.row[v] < 0) continue;
+      uint64_t *row = &dense.bits[dense.row[v] * dense.words_per_row];
+      for (int w : adjlist[v]) row[w >> 6] |= uint64_t(1) << (w & 63);
+    }
+    return dense;
+  }
+
+  template <typename Lists>
+  int64_t SimplifyLists(Lists &adjlist) {
+    int64_t dropped = 0;
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(+ : dropped)
+    for (int64_t v = 0; v < (int64_t)adjlist.size(); v++) {
+      auto &list = adjlist[v];
+      sort(list.begin(), list.end());
+      auto last = remove(list.begin(), unique(list.begin(), list.end()), (int)v);
+      dropped += list.end() - last;
+      list.resize(last - list.begin());
+    }
+    return dropped;
+  }
+
+  // Shared by BuildTSGraph and BuildGraph
+  template <typename Lists>
+  void BuildLists(const vector <pair<int, int> > &edges, bool simplify, int64_t *dropped,
+                  Lists &adjlist) {
+    int64_t max_node = 0;
+    for (pair<int, int> edge : edges) {
+      max_node = max<int64_t>(max_node, max(edge.first, edge.second) + int64_t(1));
+    }
+    adjlist = Lists(max_node);
+
+    for (pair<int, int> edge : edges) {
+      adjlist[edge.first].push_back(edge.second);
+    }
+    int64_t removed = simplify ? SimplifyLists(adjlist) : 0;
+    if (dropped != NULL) *dropped = removed;
+  }
+
+  // SimplifyLists for a weighted graph: the lightest of repeated edges stays
+  int64_t SimplifyWeightedLists(pvector <pvector<int> > &adjlist,
+                                pvector <pvector<int> > &weights) {
+    int64_t dropped = 0;
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(+ : dropped)
+    for (int64_t v = 0; v < (int64_t)adjlist.size(); v++) {
+      pvector<int> &list = adjlist[v], &weight = weights[v];
+      vector <pair<int, int> > edges;
+      for (size_t j = 0; j < list.size(); j++) {
+        if (list[j] != v) edges.push_back(make_pair(list[j], weight[j]));
+      }
+      sort(edges.begin(), edges.end());
+      size_t kept = 0;
+      for (size_t j = 0; j < edges.size(); j++) {
+        if (kept > 0 && list[kept - 1] == edges[j].first) continue;
+        list[kept] = edges[j].first;
+        weight[kept++] = edges[j].second;
+      }
+      dropped += list.size() - kept;
+      list.resize(kept);
+      weight.resize(kept);
+    }
+    return dropped;
+  }
+
+  const int64_t kInfDist = numeric_limits<int64_t>::max();
+
+  // Weights of the transpose, in the order Transpose lists the edges
+  pvector <pvector<int> > TransposeWeights(const pvector <pvector<int> > &adjlist,
+                                           const pvector <pvector<int> > &weights) {
+    pvector <pvector<int> > transposed(adjlist.size());
+    for (size_t i = 0; i < adjlist.size(); i++) {
+      for (size_t j = 0; j < adjlist[i].size(); j++) {
+        transposed[adjlist[i][j]].push_back(weights[i][j]);
+      }
+    }
+    return transposed;
+  }
+
+  // Parallel delta-stepping SSSP after GAP's DeltaStep. Vertices are
+  // relaxed a bucket of distances [i * delta, (i + 1) * delta) at a time:
+  // every thread files the vertices it improves into bins of its own, the
+  // team agrees on the lowest nonempty bin, and its contents are gathered
+  // into the shared frontier for the next round. frontier must hold E + 1
+  // entries. Leaves distances (kInfDist if unreachable) in dist; returns the
+  // largest finite one and a vertex at that distance.
+  pair<int64_t,int> DeltaStep(const pvector <pvector<int> > &adjlist,
+                              const pvector <pvector<int> > &weights, int source,
+                              int64_t delta, pvector<int64_t> &dist, pvector<int> &frontier) {
+    const size_t kMaxBin = numeric_limits<size_t>::max() / 2;
+    int V = adjlist.size();
+    #pragma omp parallel for
+    for (int v = 0; v < V; v++) dist[v] = kInfDist;
+    dist[source] = 0;
+    frontier[0] = source;
+
+    // Parity-indexed like the BFS's step counters: this round's bin and
+    // frontier length, and the next round's being agreed on
+    size_t bin_index[2] = {0, kMaxBin};
+    size_t frontier_tail[2] = {1, 0};
+
+    #pragma omp parallel
     {
-        for (int v = 0; v < V; v++) {
-            size_t in = 0, out = 0;
+      vector <vector<int> > local_bins;
+      for (size_t iter = 0; bin_index[iter & 1] != kMaxBin; iter++) {
+        size_t &curr_bin = bin_index[iter & 1];
+        size_t &next_bin = bin_index[(iter + 1) & 1];
+        size_t &curr_tail = frontier_tail[iter & 1];
+        size_t &next_tail = frontier_tail[(iter + 1) & 1];
 
-            for (size_t i = 0; i < radjlist[v].size(); i++) {
-                if (scc[radjlist[v][i]] == scc[v]) in++;
+        #pragma omp for nowait schedule(dynamic, 64)
+        for (size_t i = 0; i < curr_tail; i++) {
+          int u = frontier[i];
+          // settled in an earlier bin after this copy was filed
+          if (dist[u] < delta * (int64_t)curr_bin) continue;
+          for (size_t j = 0; j < adjlist[u].size(); j++) {
+            int v = adjlist[u][j];
+            int64_t new_dist = dist[u] + weights[u][j];
+            int64_t old_dist = dist[v];
+            while (new_dist < old_dist && !compare_and_swap(dist[v], old_dist, new_dist)) {
+              old_dist = dist[v];
             }
-
-            for (size_t i = 0; i < adjlist[v].size(); i++) {
-                if (scc[adjlist[v][i]] == scc[v]) out++;
+            if (new_dist < old_dist) {
+              size_t dest_bin = new_dist / delta;
+              if (dest_bin >= local_bins.size()) local_bins.resize(dest_bin + 1);
+              local_bins[dest_bin].push_back(v);
             }
+          }
+        }
+        for (size_t i = curr_bin; i < local_bins.size(); i++) {
+          if (!local_bins[i].empty()) {
+            #pragma omp critical (delta_next_bin)
+            next_bin = min(next_bin, i);
+            break;
+          }
+        }
+        #pragma omp barrier
 
-            // SCC : reverse topological order
-            // inside an SCC : decreasing order of the product of the indegree and outdegree for vertices in the same SCC
-            order[v] = make_pair(((long long)scc[v] << 32) - in * out, v);
+        #pragma omp single nowait
+        {
+          curr_bin = kMaxBin;
+          curr_tail = 0;
+        }
+        if (next_bin < local_bins.size()) {
+          size_t copy_start = fetch_and_add(next_tail, local_bins[next_bin].size());
+          copy(local_bins[next_bin].begin(), local_bins[next_bin].end(),
+               frontier.begin() + copy_start);
+          local_bins[next_bin].resize(0);
         }
+        #pragma omp barrier
+      }
+    }
+
+    int64_t height = 0;
+    #pragma omp parallel for reduction(max : height)
+    for (int v = 0; v < V; v++) {
+      if (dist[v] != kInfDist) height = max(height, dist[v]);
+    }
+    int farthest = source;
+    #pragma omp parallel for reduction(max : farthest)
+    for (int v = 0; v < V; v++) {
+      if (dist[v] == height) farthest = max(farthest, v);
+    }
+    return make_pair(height, farthest);
+  }
+
+  // Delta about the heaviest edge over the average degree: a bucket then
+  // holds roughly one hop's worth of relaxations
+  int64_t PickDelta(const pvector <pvector<int> > &weights, int64_t num_edges) {
+    int max_weight = 1;
+    #pragma omp parallel for reduction(max : max_weight)
+    for (size_t v = 0; v < weights.size(); v++) {
+      for (int w : weights[v]) max_weight = max(max_weight, w);
+    }
+    int64_t average_degree = max<int64_t>(1, num_edges / max<int64_t>(1, weights.size()));
+    return max<int64_t>(1, max_weight / average_degree);
+  }
+} // end namespace
+
+namespace Diameter{
+  pvector <pvector<int> > BuildTSGraph(const vector <pair<int, int> > &edges, bool simplify,
+                                       int64_t *dropped) {
+    pvector <pvector<int> > adjlist;
+    BuildLists(edges, simplify, dropped, adjlist);
+    return adjlist;
+  }
+
+  vector <vector<int> > BuildGraph(const vector <pair<int, int> > &edges, bool simplify,
+                                   int64_t *dropped) {
+    vector <vector<int> > adjlist;
+    BuildLists(edges, simplify, dropped, adjlist);
+    return adjlist;
+  }
+
+  int64_t SimplifyGraph(pvector <pvector<int> > &adjlist) {
+    return SimplifyLists(adjlist);
+  }
+
+  int64_t SimplifyGraph(vector <vector<int> > &adjlist) {
+    return SimplifyLists(adjlist);
+  }
 
-        sort(order.begin(), order.end());
+  void BuildWeightedGraph(const vector<Generator::WeightedEdge> &edges,
+                          pvector <pvector<int> > &adjlist,
+                          pvector <pvector<int> > &weights,
+                          bool simplify, int64_t *dropped) {
+    int64_t max_node = 0;
+    for (const Generator::WeightedEdge &edge : edges) {
+      max_node = max<int64_t>(max_node, max(edge.from, edge.to) + int64_t(1));
+    }
+    adjlist = pvector <pvector<int> >(max_node);
+    weights = pvector <pvector<int> >(max_node);
+
+    for (const Generator::WeightedEdge &edge : edges) {
+      adjlist[edge.from].push_back(edge.to);
+      weights[edge.from].push_back(edge.weight);
+    }
+    int64_t removed = simplify ? SimplifyWeightedLists(adjlist, weights) : 0;
+    if (dropped != NULL) *dropped = removed;
+  }
+
+  DiameterSolver::DiameterSolver(const pvector <pvector<int> > &adjlist,
+                                 bool tune_direction)
+      : adjlist_(adjlist), V_(adjlist.size()), tune_direction_(tune_direction),
+        has_radjlist_(false), has_scc_(false), has_order_(false),
+        has_direction_(false), has_segments_(false), has_dense_(false),
+        segment_width_(kDefaultSegmentWidth), distance_bytes_(1),
+        diameter_(-1), radius_(-1), ecc_(adjlist.size(), -1),
+        checkpoint_interval_(600), sweeps_(kDefaultSweeps) {}
+
+  void DiameterSolver::SetCheckpoint(const string &filename, double interval_seconds) {
+    lock_guard<recursive_mutex> lock(mutex_);
+    checkpoint_file_ = filename;
+    checkpoint_interval_ = interval_seconds;
+  }
+
+  void DiameterSolver::SetSweeps(const SweepOptions &sweeps) {
+    lock_guard<recursive_mutex> lock(mutex_);
+    sweeps_ = sweeps;
+  }
+
+  void DiameterSolver::SetWhiskerDepths(const vector<int> &depth) {
+    lock_guard<recursive_mutex> lock(mutex_);
+    depth_ = depth;
+    diameter_ = -1;
+  }
+
+  void DiameterSolver::SetDirectionTuning(bool tune_direction) {
+    lock_guard<recursive_mutex> lock(mutex_);
+    tune_direction_ = tune_direction;
+  }
+
+  void DiameterSolver::SetSegmentWidth(int64_t width) {
+    lock_guard<recursive_mutex> lock(mutex_);
+    if (width == segment_width_) return;
+    segment_width_ = width;
+    has_segments_ = false;
+    segments_ = SegmentedGraph();
+    rsegments_ = SegmentedGraph();
+  }
+
+  BFSLayout DiameterSolver::GetLayout(bool transpose) {
+    lock_guard<recursive_mutex> lock(mutex_);
+    if (!has_dense_) {
+      dense_ = BuildDenseRows(adjlist_);
+      rdense_ = BuildDenseRows(GetTranspose());
+      has_dense_ = true;
+    }
+    bool segmented = segment_width_ > 0 && V_ > segment_width_;
+    if (segmented && !has_segments_) {
+      rsegments_ = SegmentGraph(GetTranspose(), segment_width_);
+      segments_ = SegmentGraph(adjlist_, segment_width_);
+      has_segments_ = true;
+    }
+    const DenseRows *dense = dense_.words_per_row > 0 ? &dense_ : NULL;
+    const DenseRows *rdense = rdense_.words_per_row > 0 ? &rdense_ : NULL;
+    BFSLayout forward = {dense, rdense, segmented ? &rsegments_ : NULL};
+    BFSLayout backward = {rdense, dense, segmented ? &segments_ : NULL};
+    return transpose ? backward : forward;
+  }
+
+  const pvector <pvector<int> > &DiameterSolver::GetTranspose() {
+    lock_guard<recursive_mutex> lock(mutex_);
+    if (!has_radjlist_) {
+      radjlist_ = Transpose(adjlist_);
+      has_radjlist_ = true;
+    }
+    return radjlist_;
+  }
+
+  const pvector<int> &DiameterSolver::GetSCC() {
+    lock_guard<recursive_mutex> lock(mutex_);
+    if (!has_scc_) {
+      scc_ = pvector<int>(V_);
+      DecomposeSCC(adjlist_, scc_);
+      has_scc_ = true;
+    }
+    return scc_;
+  }
+
+  const pvector<int> &DiameterSolver::GetOrder() {
+    lock_guard<recursive_mutex> lock(mutex_);
+    if (!has_order_) {
+      order_ = OrderVertices(adjlist_, GetTranspose(), GetSCC());
+      has_order_ = true;
+    }
+    return order_;
+  }
+
+  DirectionParams DiameterSolver::GetDirection() {
+    lock_guard<recursive_mutex> lock(mutex_);
+    if (!has_direction_) {
+      direction_ = kDefaultDirection;
+      if (tune_direction_) direction_ = TuneDirection(adjlist_, GetTranspose());
+      has_direction_ = true;
+    }
+    return direction_;
+  }
+
+  int DiameterSolver::GetEccentricity(int v) {
+    lock_guard<recursive_mutex> lock(mutex_);
+    if (ecc_[v] < 0) {
+      BFSLayout forward = GetLayout(false);
+      NarrowDistances narrow(distance_bytes_);
+      ecc_[v] = BFSHeightParallel(adjlist_, GetTranspose(), v, GetDirection(), narrow,
+                                  &forward).first;
+      distance_bytes_ = narrow.bytes;
+    }
+    return ecc_[v];
+  }
+
+  // Code as from @kawatea on GitHub <3. Whiskers are bounded as in
+  // GetFastDiam.
+  int DiameterSolver::GetDiameter() {
+    lock_guard<recursive_mutex> lock(mutex_);
+    if (diameter_ >= 0) return diameter_;
+    if (V_ == 0) return diameter_ = 0;
+    const vector<int> &depth = depth_;
+    int max_ecc = V_ + (depth.empty() ? 0 : *max_element(depth.begin(), depth.end()));
+
+    // Pick up a previous run of this graph if one left a checkpoint
+    int64_t num_edges = NumEdges(adjlist_);
+    uint64_t fingerprint = checkpoint_file_.empty() ? 0 :
+                           GraphFingerprint(adjlist_) + DepthFingerprint(depth);
+    Checkpoint checkpoint;
+    bool resumed = !checkpoint_file_.empty() &&
+                   LoadCheckpoint(checkpoint_file_, V_, num_edges, fingerprint, max_ecc,
+                                  checkpoint);
+    if (resumed) {
+      scc_ = pvector<int>(checkpoint.scc.data(), checkpoint.scc.data() + V_);
+      order_ = pvector<int>(checkpoint.order.data(), checkpoint.order.data() + V_);
+      has_scc_ = has_order_ = true;
+    }
+
+    const pvector <pvector<int> > &adjlist = adjlist_;
+    const pvector <pvector<int> > &radjlist = GetTranspose();
+    const pvector<int> &scc = GetSCC();
+    const pvector<int> &order = GetOrder();
+    DirectionParams params = GetDirection();
+    const BFSLayout forward = GetLayout(false), backward = GetLayout(true);
+    int diameter = 0, V = V_;
+    NarrowDistances narrow(distance_bytes_);
+
+    // Eccentricities already known from earlier queries bound the diameter
+    #pragma omp parallel for reduction(max : diameter)
+    for (int v = 0; v < V; v++) diameter = max(diameter, ecc_[v]);
+
+    // Compute the diameter lower bound by the double sweep algorithm. The
+    // sweeps are independent, so the team splits into groups (as many as
+    // there are sweeps and workspace allows) that each run whole sweeps
+    // with the parallel BFS.
+    if (resumed) {
+        diameter = max(diameter, checkpoint.diameter);
+    } else {
+        vector<int> candidates = SweepCandidates(adjlist, radjlist, scc, sweeps_);
+        int num_threads = omp_get_max_threads();
+        int groups = max(1, min(sweeps_.count, num_threads / BruteGroupWidth(V, num_threads)));
+        int width = max(1, num_threads / groups);
+        int next_task = 0;
+        int max_levels = omp_get_max_active_levels();
+        omp_set_max_active_levels(2);
+        #pragma omp parallel num_threads(groups) reduction(max : diameter)
+        {
+            omp_set_num_threads(width);  // for the BFS teams nested below
+            pvector<int> sweep_distance(V);
+            for (int task = fetch_and_add(next_task, 1); task < sweeps_.count;
+                 task = fetch_and_add(next_task, 1)) {
+                int start = SweepSource(sweeps_, task, candidates, V);
+
+                for (int round = 0; round < (sweeps_.start == SWEEP_FOUR ? 2 : 1); round++) {
+                    // forward BFS
+                    pair<int,int> dist_node = BFSParallel(adjlist, radjlist, start, params,
+                                                          sweep_distance, &forward);
+                    #pragma omp critical (sweep_ecc)
+                    ecc_[start] = dist_node.first;
+                    diameter = max(diameter, dist_node.first);
+
+                    // backward BFS, leaving sweep_distance[v] = d(v, farthest)
+                    dist_node = BFSParallel(radjlist, adjlist, dist_node.second, params,
+                                            sweep_distance, &backward);
+                    diameter = max(diameter, dist_node.first);
+
+                    // the next round starts halfway down a shortest path back
+                    start = dist_node.second;
+                    for (int step = 0; step < dist_node.first / 2; step++) {
+                        for (int w : adjlist[start]) {
+                            if (sweep_distance[w] == sweep_distance[start] - 1) {
+                                start = w;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        omp_set_max_active_levels(max_levels);
     }
 
     // Examine every vertex
     int qs, qt;
     pvector <int> dist(V, -1);
     pvector <int> queue(V);
-    pvector <int> ecc(V, V);
+    pvector <int> ecc(V, max_ecc);
+    size_t first = 0;
+    if (resumed) {
+        #pragma omp parallel for
+        for (int v = 0; v < V; v++) ecc[v] = checkpoint.ecc[v];
+        first = checkpoint.next;
+    }
+    double last_save = omp_get_wtime();
+    auto save = [&](size_t next) {
+        Checkpoint progress = {V, num_edges, fingerprint, diameter, (int64_t)next,
+                               vector<int>(scc.begin(), scc.end()),
+                               vector<int>(order.begin(), order.end()),
+                               vector<int>(ecc.begin(), ecc.end())};
+        if (!SaveCheckpoint(checkpoint_file_, progress)) {
+            fprintf(stderr, "Can't write checkpoint %s\n", checkpoint_file_.c_str());
+        }
+        last_save = omp_get_wtime();
+    };
+    if (!checkpoint_file_.empty() && !resumed) save(0);
     {
-        for (size_t i = 0; i < V; i++) {
-            int u = order[i].second;
+        for (size_t i = first; i < V; i++) {
+            int u = order[i];
 
-            if (ecc[u] <= diameter) continue;
+            int own = depth.empty() ? 0 : depth[u];
+            if (own + ecc[u] <= diameter) continue;
 
             // Refine the eccentricity upper bound
-            int ub = 0;
-            pvector <pair<int, int> > neighbors;
+            int ub = own;
+            vector <pair<int, int> > neighbors;
 
             for (size_t j = 0; j < adjlist[u].size(); j++) neighbors.push_back(make_pair(scc[adjlist[u][j]], ecc[adjlist[u][j]] + 1));
 
@@ -298,7 +1563,7 @@ namespace Diameter{
 
             for (size_t j = 0; j < neighbors.size(); ) {
                 int component = neighbors[j].first;
-                int lb = V;
+                int lb = max_ecc;
 
                 for (; j < neighbors.size(); j++) {
                     if (neighbors[j].first != component) break;
@@ -307,18 +1572,23 @@ namespace Diameter{
 
                 ub = max(ub, lb);
 
-                if (ub > diameter) break;
+                if (own + ub > diameter) break;
             }
 
-            if (ub <= diameter) {
+            if (own + ub <= diameter) {
                 ecc[u] = ub;
                 continue;
             }
 
-            // Conduct a BFS and update bounds
-            pair<int,int> dist_node = BFSHeightParallel(adjlist, radjlist, u);
-            ecc[u] = dist_node.first;
-            diameter = max(diameter, ecc[u]);
+            // Conduct a BFS (unless an earlier query already did, and there
+            // are no whiskers to count on its distances) and update bounds
+            if (ecc_[u] < 0 || !depth.empty()) {
+                ecc_[u] = BFSHeightParallel(adjlist, radjlist, u, params, narrow, &forward).first;
+                distance_bytes_ = narrow.bytes;
+            }
+            int height = depth.empty() ? ecc_[u] : WhiskerHeight(narrow, u, depth);
+            ecc[u] = max(height - own, own);
+            diameter = max(diameter, height);
 
             qs = qt = 0;
             dist[u] = 0;
@@ -339,18 +1609,376 @@ namespace Diameter{
             }
 
             for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
+
+            if (!checkpoint_file_.empty() && omp_get_wtime() - last_save >= checkpoint_interval_) {
+                save(i + 1);
+            }
         }
     }
-    return diameter;
+    if (!checkpoint_file_.empty()) remove(checkpoint_file_.c_str());
+    return diameter_ = diameter;
   }
 
-  int GetBruteDiamParallel(const pvector <pvector<int> > &adjlist) {
+  // Bounding search for the smallest eccentricity: a forward BFS from u
+  // gives ecc(w) >= ecc(u) - d(u, w) for w in u's SCC (both reach the same
+  // vertices), and a backward BFS gives ecc(w) >= d(w, u) for every w.
+  // Vertices are examined by increasing lower bound until none can beat
+  // the best eccentricity found.
+  int DiameterSolver::GetRadius() {
+    lock_guard<recursive_mutex> lock(mutex_);
+    if (radius_ >= 0) return radius_;
+    if (V_ == 0) return radius_ = 0;
+
+    const pvector <pvector<int> > &adjlist = adjlist_;
+    const pvector <pvector<int> > &radjlist = GetTranspose();
+    const pvector<int> &scc = GetSCC();
+    DirectionParams params = GetDirection();
+    const BFSLayout forward = GetLayout(false), backward = GetLayout(true);
+    int V = V_, radius = V;
+    pvector<int> lb(V, 0);
+    pvector<int> distance(V);
+
+    for (int v = 0; v < V; v++) {
+      if (ecc_[v] >= 0) {
+        radius = min(radius, ecc_[v]);
+        lb[v] = ecc_[v];
+      }
+    }
+
+    while (true) {
+      // Unexamined vertex with the smallest bound, preferring high degree
+      int u = -1;
+      for (int v = 0; v < V; v++) {
+        if (ecc_[v] >= 0 || lb[v] >= radius) continue;
+        if (u < 0 || lb[v] < lb[u] ||
+            (lb[v] == lb[u] && adjlist[v].size() > adjlist[u].size())) u = v;
+      }
+      if (u < 0) break;
+
+      ecc_[u] = BFSParallel(adjlist, radjlist, u, params, distance, &forward).first;
+      radius = min(radius, ecc_[u]);
+      lb[u] = ecc_[u];
+      #pragma omp parallel for
+      for (int w = 0; w < V; w++) {
+        if (distance[w] >= 0 && scc[w] == scc[u]) lb[w] = max(lb[w], ecc_[u] - distance[w]);
+      }
+
+      BFSParallel(radjlist, adjlist, u, params, distance, &backward);
+      #pragma omp parallel for
+      for (int w = 0; w < V; w++) {
+        lb[w] = max(lb[w], distance[w]);
+      }
+    }
+    return radius_ = radius;
+  }
+
+  // The bounding loop of GetDiameter over the members of one SCC. Distances
+  // between members are the same in the whole graph, so the forward BFSes
+  // are the unrestricted parallel ones and only their members count.
+  int DiameterSolver::GetComponentDiameter(int c) {
+    lock_guard<recursive_mutex> lock(mutex_);
+    map<int, int>::iterator cached = component_diameter_.find(c);
+    if (cached != component_diameter_.end()) return cached->second;
+
+    const pvector<int> &scc = GetSCC();
+    const pvector<int> &order = GetOrder();
+
+    vector<int> members;
+    for (int i = 0; i < V_; i++) {
+      if (scc[order[i]] == c) members.push_back(order[i]);
+    }
+    return component_diameter_[c] = ComponentDiameterParallel(c, members);
+  }
+
+  int DiameterSolver::ComponentDiameterParallel(int c, const vector<int> &members) {
+    const pvector <pvector<int> > &adjlist = adjlist_;
+    const pvector <pvector<int> > &radjlist = GetTranspose();
+    const pvector<int> &scc = GetSCC();
+    DirectionParams params = GetDirection();
+    const BFSLayout forward = GetLayout(false), backward = GetLayout(true);
+
     int diameter = 0;
+    if (members.size() > 1) {
+      pvector<int> distance(V_);
+      pvector<int> dist(V_, -1);
+      pvector<int> queue(V_);
+      pvector<int> ecc(V_, V_);  // upper bounds, only members' are used
+
+      // Double sweeps from random members seed the lower bound, as in
+      // GetDiameter; the sweep paths between members stay inside c
+      for (int task = 0; task < sweeps_.count; task++) {
+        RandomState random(sweeps_.seed, task);
+        int source = members[GetRandom(random, members.size())];
+        for (int pass = 0; pass < 2; pass++) {
+          if (pass == 0) BFSParallel(adjlist, radjlist, source, params, distance, &forward);
+          else BFSParallel(radjlist, adjlist, source, params, distance, &backward);
+          int farthest = source;
+          for (int v : members) {
+            if (distance[v] > distance[farthest]) farthest = v;
+          }
+          diameter = max(diameter, distance[farthest]);
+          source = farthest;
+        }
+      }
+
+      for (int u : members) {
+        if (ecc[u] <= diameter) continue;
+
+        // Single component, so the bound is the best out-neighbor's plus one
+        int ub = V_;
+        for (int w : adjlist[u]) {
+          if (scc[w] == c) ub = min(ub, ecc[w] + 1);
+        }
+        if (ub <= diameter) {
+          ecc[u] = ub;
+          continue;
+        }
+
+        BFSParallel(adjlist, radjlist, u, params, distance, &forward);
+        int height = 0;
+        #pragma omp parallel for reduction(max : height)
+        for (size_t i = 0; i < members.size(); i++) height = max(height, distance[members[i]]);
+        ecc[u] = height;
+        diameter = max(diameter, height);
+
+        int qs = 0, qt = 0;
+        dist[u] = 0;
+        queue[qt++] = u;
+        while (qs < qt) {
+          int v = queue[qs++];
+          ecc[v] = min(ecc[v], dist[v] + ecc[u]);
+          for (int w : radjlist[v]) {
+            if (dist[w] < 0 && scc[w] == c) {
+              dist[w] = dist[v] + 1;
+              queue[qt++] = w;
+            }
+          }
+        }
+        for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
+      }
+    }
+    return diameter;
+  }
+
+  vector<ComponentDiameter> DiameterSolver::GetComponentDiameters(int min_size) {
+    lock_guard<recursive_mutex> lock(mutex_);
+    const pvector <pvector<int> > &adjlist = adjlist_;
+    const pvector <pvector<int> > &radjlist = GetTranspose();
+    const pvector<int> &scc = GetSCC();
+    const pvector<int> &order = GetOrder();
+
+    // The order groups every SCC into one run; start of each row's run
+    vector<ComponentDiameter> table;
+    vector<int> start;
+    for (int i = 0, j; i < V_; i = j) {
+      for (j = i + 1; j < V_ && scc[order[j]] == scc[order[i]]; j++) {}
+      if (j - i < max(min_size, 1)) continue;
+      map<int, int>::iterator cached = component_diameter_.find(scc[order[i]]);
+      ComponentDiameter row = {scc[order[i]], j - i,
+                               cached == component_diameter_.end() ? -1 : cached->second};
+      table.push_back(row);
+      start.push_back(i);
+    }
+    vector<int> rows(table.size());
+    for (size_t r = 0; r < rows.size(); r++) rows[r] = r;
+    stable_sort(rows.begin(), rows.end(), [&](int a, int b) {
+      return table[a].size > table[b].size;
+    });
+
+    int num_threads = omp_get_max_threads();
+    vector<int> serial;
+    for (int r : rows) {
+      if (table[r].diameter >= 0) continue;
+      if (table[r].size >= kMinParallelComponent && (int64_t)table[r].size * num_threads >= V_) {
+        vector<int> members(order.begin() + start[r], order.begin() + start[r] + table[r].size);
+        table[r].diameter = ComponentDiameterParallel(table[r].component, members);
+      } else {
+        serial.push_back(r);
+      }
+    }
+
+    // Largest first, so the stragglers are the cheap ones
+    if (!serial.empty()) {
+      pvector<int> ecc(V_, V_);
+      #pragma omp parallel
+      {
+        pvector<int> dist(V_, -1);
+        pvector<int> queue(V_);
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t i = 0; i < serial.size(); i++) {
+          ComponentDiameter &row = table[serial[i]];
+          row.diameter = SerialComponentDiameter(adjlist, radjlist, scc, row.component,
+                                                 &order[start[serial[i]]], row.size, sweeps_,
+                                                 ecc, dist, queue);
+        }
+      }
+    }
+
+    vector<ComponentDiameter> sorted;
+    for (int r : rows) {
+      component_diameter_[table[r].component] = table[r].diameter;
+      sorted.push_back(table[r]);
+    }
+    return sorted;
+  }
+
+  int GetFastDiamParallel(const pvector <pvector<int> > &adjlist, bool tune_direction,
+                          const string &checkpoint_file, double checkpoint_interval,
+                          const SweepOptions &sweeps, int64_t segment_width,
+                          const vector<int> &depth) {
+    DiameterSolver solver(adjlist, tune_direction);
+    solver.SetCheckpoint(checkpoint_file, checkpoint_interval);
+    solver.SetSweeps(sweeps);
+    solver.SetSegmentWidth(segment_width);
+    solver.SetWhiskerDepths(depth);
+    return solver.GetDiameter();
+  }
+
+  int BFSDistancesParallel(const pvector <pvector<int> > &adjlist,
+                           const pvector <pvector<int> > &radjlist, int source,
+                           pvector<int> &distance, DirectionParams params) {
+    return BFSParallel(adjlist, radjlist, source, params, Sized(distance, adjlist.size())).first;
+  }
+
+  // Sources are claimed from a shared counter, so whichever thread or group
+  // runs out of work first keeps taking the remaining ones.
+  int GetBruteDiamParallel(const pvector <pvector<int> > &adjlist, bool tune_direction,
+                           const vector<int> &depth) {
+    int diameter = 0, V = adjlist.size();
+    int num_threads = omp_get_max_threads();
+    int width = BruteGroupWidth(V, num_threads);
+    int next_source = 0;
+
+    if (width == 1) {
+      #pragma omp parallel reduction(max : diameter)
+      {
+        pvector<int> dist(V, -1);
+        pvector<int> queue(V);
+        for (int s = fetch_and_add(next_source, 1); s < V; s = fetch_and_add(next_source, 1)) {
+          diameter = max(diameter, SerialBFSHeight(adjlist, s, depth, dist, queue));
+        }
+      }
+      return diameter;
+    }
+
     const pvector <pvector<int> > radjlist = Transpose(adjlist);
+    DirectionParams params = kDefaultDirection;
+    if (tune_direction) params = TuneDirection(adjlist, radjlist);
+    int max_levels = omp_get_max_active_levels();
+    omp_set_max_active_levels(2);
+    #pragma omp parallel num_threads(num_threads / width) reduction(max : diameter)
+    {
+      omp_set_num_threads(width);  // for the BFS teams nested below
+      NarrowDistances narrow;
+      for (int s = fetch_and_add(next_source, 1); s < V; s = fetch_and_add(next_source, 1)) {
+        int height = BFSHeightParallel(adjlist, radjlist, s, params, narrow).first;
+        if (!depth.empty()) height = WhiskerHeight(narrow, s, depth);
+        diameter = max(diameter, height);
+      }
+    }
+    omp_set_max_active_levels(max_levels);
+    return diameter;
+  }
 
-    #pragma omp parallel for reduction(max: diameter)
-    for (size_t i = 0; i < adjlist.size(); i++) {
-      diameter = max(diameter, BFSHeightParallel(adjlist, radjlist, i).first);
+  // The @kawatea bounding algorithm over weighted distances. A vertex
+  // reaches everything its out-neighbors in one SCC reach, so
+  // ecc(u) <= max over those SCCs of min (weight + ecc) of the neighbors in
+  // it, and a vertex v of u's SCC has ecc(v) <= d(v, u) + ecc(u), with d
+  // from a Dijkstra restricted to the SCC on the transpose.
+  int64_t GetFastDiamWeighted(const pvector <pvector<int> > &adjlist,
+                              const pvector <pvector<int> > &weights, int64_t delta,
+                              const SweepOptions &sweeps) {
+    int V = adjlist.size();
+    if (V == 0) return 0;
+
+    // Structure only, shared with the unweighted engine
+    DiameterSolver structure(adjlist, false);
+    const pvector <pvector<int> > &radjlist = structure.GetTranspose();
+    const pvector<int> &scc = structure.GetSCC();
+    const pvector<int> &order = structure.GetOrder();
+    const pvector <pvector<int> > rweights = TransposeWeights(adjlist, weights);
+    int64_t num_edges = NumEdges(adjlist);
+    if (delta <= 0) delta = PickDelta(weights, num_edges);
+
+    pvector<int64_t> dist(V);
+    pvector<int> frontier(num_edges + 1);
+    int64_t diameter = 0;
+
+    // Compute the diameter lower bound by the double sweep algorithm
+    vector<int> candidates = SweepCandidates(adjlist, radjlist, scc, sweeps);
+    for (int task = 0; task < sweeps.count; task++) {
+      int source = SweepSource(sweeps, task, candidates, V);
+      pair<int64_t,int> dist_node = DeltaStep(adjlist, weights, source, delta, dist, frontier);
+      diameter = max(diameter, dist_node.first);
+      diameter = max(diameter, DeltaStep(radjlist, rweights, dist_node.second, delta,
+                                         dist, frontier).first);
+    }
+
+    // Examine every vertex
+    pvector<int64_t> ecc(V, kInfDist);
+    pvector<int64_t> back(V, kInfDist);
+    vector<int> touched;
+    for (int i = 0; i < V; i++) {
+      int u = order[i];
+
+      if (ecc[u] <= diameter) continue;
+
+      // Refine the eccentricity upper bound
+      int64_t ub = 0;
+      vector <pair<int, int64_t> > neighbors;
+      for (size_t j = 0; j < adjlist[u].size(); j++) {
+        int w = adjlist[u][j];
+        neighbors.push_back(make_pair(scc[w], ecc[w] == kInfDist ? kInfDist : ecc[w] + weights[u][j]));
+      }
+      sort(neighbors.begin(), neighbors.end());
+
+      for (size_t j = 0; j < neighbors.size(); ) {
+        int component = neighbors[j].first;
+        int64_t lb = kInfDist;
+
+        for (; j < neighbors.size(); j++) {
+          if (neighbors[j].first != component) break;
+          lb = min(lb, neighbors[j].second);
+        }
+
+        ub = max(ub, lb);
+
+        if (ub > diameter) break;
+      }
+
+      if (ub <= diameter) {
+        ecc[u] = ub;
+        continue;
+      }
+
+      // Conduct an SSSP and update bounds
+      ecc[u] = DeltaStep(adjlist, weights, u, delta, dist, frontier).first;
+      diameter = max(diameter, ecc[u]);
+
+      priority_queue <pair<int64_t, int>, vector <pair<int64_t, int> >,
+                      greater <pair<int64_t, int> > > heap;
+      back[u] = 0;
+      touched.push_back(u);
+      heap.push(make_pair(0, u));
+      while (!heap.empty()) {
+        pair<int64_t, int> top = heap.top();
+        heap.pop();
+        int v = top.second;
+        if (top.first > back[v]) continue;
+
+        ecc[v] = min(ecc[v], back[v] + ecc[u]);
+
+        for (size_t j = 0; j < radjlist[v].size(); j++) {
+          int w = radjlist[v][j];
+          // only inside an SCC
+          if (scc[w] != scc[u] || back[v] + rweights[v][j] >= back[w]) continue;
+          if (back[w] == kInfDist) touched.push_back(w);
+          back[w] = back[v] + rweights[v][j];
+          heap.push(make_pair(back[w], w));
+        }
+      }
+      for (int v : touched) back[v] = kInfDist;
+      touched.clear();
     }
     return diameter;
   }
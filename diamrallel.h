@@ -2,20 +2,214 @@
 # define DIAMRALLEL_H
 
 #include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
 #include <vector>
 #include <algorithm>
 #include <sys/time.h>
 #include "ForParallelFromBeamer/pvector.h"
+#include "diameter.h"
+#include "graphgen.h"
 
 using namespace std;
 
 namespace Diameter {
-  int GetFastDiamParallel(const pvector <pvector<int> > &adjlist);
+  // Thresholds of the direction-optimizing BFS: go bottom-up once the
+  // frontier has more than 1/alpha of the unexplored edges, and back
+  // top-down once it holds fewer than 1/beta of the vertices.
+  struct DirectionParams {
+    int alpha, beta;
+  };
 
-  int GetBruteDiamParallel(const pvector <pvector<int> > &adjlist);
+  // GAP's defaults, tuned for undirected Kronecker graphs
+  const DirectionParams kDefaultDirection = {15, 18};
 
-  // Build thread-safe graph
-  pvector <pvector<int> > BuildTSGraph(const vector <pair<int, int> > &edges);
+  // Reverse adjacency cut by neighbor range for the bottom-up BFS step:
+  // segment s lists, for each vertex that has any, its neighbors in
+  // [s * width, (s + 1) * width). Walking one segment at a time, a
+  // bottom-up step only probes that slice of the frontier bitmap, which
+  // can stay in cache when the whole bitmap does not.
+  struct SegmentedGraph {
+    struct Segment {
+      pvector<int> vertices;
+      pvector<int64_t> offsets;  // of each vertex's neighbors, plus the end
+      pvector<int> neighbors;
+    };
+    int64_t width;
+    vector<Segment> segments;
+  };
+
+  // 2^27 vertices: a 16 MB slice of the bitmap
+  const int64_t kDefaultSegmentWidth = int64_t(1) << 27;
+
+  // Neighbor sets of vertices with at least V / kDenseRowDivisor neighbors
+  // as bitmap rows, no bigger than their lists, so BFS steps can test a row
+  // against a bitmap a word at a time instead of probing edge by edge
+  struct DenseRows {
+    int64_t words_per_row;
+    pvector<int> row;        // of each vertex, -1 if it only has its list
+    pvector<uint64_t> bits;  // row r is the words_per_row words from r * words_per_row
+  };
+
+  const int kDenseRowDivisor = 32;
+
+  // What a BFS in one direction may use besides the lists: its top-down
+  // lists as dense rows, and its bottom-up lists as dense rows and
+  // segments. Any may be NULL.
+  struct BFSLayout {
+    const DenseRows *dense, *rdense;
+    const SegmentedGraph *rsegments;
+  };
+
+  // With tune_direction the thresholds are calibrated on a few sampled
+  // sources first and reused by every BFS of the run. Checkpointing works
+  // as in GetFastDiam; segment_width as in DiameterSolver::SetSegmentWidth.
+  // depth as for GetFastDiam.
+  int GetFastDiamParallel(const pvector <pvector<int> > &adjlist,
+                          bool tune_direction = true, const string &checkpoint_file = "",
+                          double checkpoint_interval = 600,
+                          const SweepOptions &sweeps = kDefaultSweeps,
+                          int64_t segment_width = kDefaultSegmentWidth,
+                          const vector<int> &depth = vector<int>());
+
+  // tune_direction as for GetFastDiamParallel; it only matters when the
+  // sources are split across nested BFS teams.
+  int GetBruteDiamParallel(const pvector <pvector<int> > &adjlist,
+                           bool tune_direction = true,
+                           const vector<int> &depth = vector<int>());
+
+  // Direction-optimizing parallel BFS from source, as the engines run it;
+  // leaves every vertex's distance (-1 if unreached) in distance, sized to
+  // V, and returns the height of the BFS tree
+  int BFSDistancesParallel(const pvector <pvector<int> > &adjlist,
+                           const pvector <pvector<int> > &radjlist, int source,
+                           pvector<int> &distance, DirectionParams params = kDefaultDirection);
+
+  // One row of DiameterSolver::GetComponentDiameters
+  struct ComponentDiameter {
+    int component;  // SCC label, as in GetSCC
+    int size;
+    int diameter;
+  };
+
+  // Wraps a graph (which must outlive it) and caches everything the engine
+  // derives from it: transpose, SCC labels, vertex order, BFS thresholds and
+  // every exact eccentricity found so far. Each piece is built the first
+  // time a query needs it, so repeated queries only pay for BFS work.
+  // Queries may come from several threads: they take turns on an internal
+  // lock, and each one runs its BFSes on the whole OpenMP team.
+  class DiameterSolver {
+   public:
+    explicit DiameterSolver(const pvector <pvector<int> > &adjlist,
+                            bool tune_direction = true);
+
+    // Longest shortest path, by the @kawatea bounding algorithm
+    int GetDiameter();
+
+    // Height of the BFS tree rooted at v
+    int GetEccentricity(int v);
+
+    // Smallest eccentricity of any vertex
+    int GetRadius();
+
+    // Longest shortest path between two vertices of SCC c (a label as in
+    // GetSCC); such paths never leave the SCC
+    int GetComponentDiameter(int c);
+
+    // GetComponentDiameter of every SCC with at least min_size vertices,
+    // largest first, in one pass. SCCs too small to keep a team busy are
+    // bounded concurrently, one per thread; the rest take turns on the
+    // parallel BFS.
+    vector<ComponentDiameter> GetComponentDiameters(int min_size = 2);
+
+    // Makes GetDiameter save its progress to filename every interval_seconds
+    // and resume from it if it exists
+    void SetCheckpoint(const string &filename, double interval_seconds);
+
+    // Double sweeps GetDiameter seeds its lower bound with
+    void SetSweeps(const SweepOptions &sweeps);
+
+    // Whether the BFS thresholds get calibrated, until they are first used
+    void SetDirectionTuning(bool tune_direction);
+
+    // Whisker depths for GetDiameter to count, as in GetFastDiam; the other
+    // queries ignore them
+    void SetWhiskerDepths(const vector<int> &depth);
+
+    // Bottom-up steps on graphs of more than this many vertices walk the
+    // reverse graph as a SegmentedGraph of this width, built once and kept
+    // for every BFS; 0 never segments
+    void SetSegmentWidth(int64_t width);
+
+    int NumVertices() const { return V_; }
+    const pvector <pvector<int> > &GetGraph() const { return adjlist_; }
+    const pvector <pvector<int> > &GetTranspose();
+    const pvector<int> &GetSCC();
+    // Vertices in the order the bounding loop examines them
+    const pvector<int> &GetOrder();
+    DirectionParams GetDirection();
+
+   private:
+    // What forward BFSes (or, with transpose, backward ones) may use
+    BFSLayout GetLayout(bool transpose);
+
+    // GetComponentDiameter, given the members of c in examination order
+    int ComponentDiameterParallel(int c, const vector<int> &members);
+
+    const pvector <pvector<int> > &adjlist_;
+    int V_;
+    bool tune_direction_;
+    bool has_radjlist_, has_scc_, has_order_, has_direction_, has_segments_, has_dense_;
+    pvector <pvector<int> > radjlist_;
+    int64_t segment_width_;
+    SegmentedGraph segments_, rsegments_;  // of adjlist_ and radjlist_
+    DenseRows dense_, rdense_;             // likewise, words_per_row 0 if none
+    int distance_bytes_;  // per distance of the height-only BFSes, widened as they deepen
+    pvector<int> scc_, order_;
+    DirectionParams direction_;
+    int diameter_, radius_;  // -1 until computed
+    pvector<int> ecc_;       // exact eccentricities, -1 if unknown
+    map<int, int> component_diameter_;
+    string checkpoint_file_;
+    double checkpoint_interval_;
+    SweepOptions sweeps_;
+    vector<int> depth_;      // empty for none
+    recursive_mutex mutex_;  // queries call the lazy accessors while holding it
+  };
+
+  // Build thread-safe graph. With simplify, lists come out as SimplifyGraph
+  // leaves them; dropped, if given, is set to the edges that removed.
+  pvector <pvector<int> > BuildTSGraph(const vector <pair<int, int> > &edges,
+                                       bool simplify = false, int64_t *dropped = NULL);
+
+  // The same as plain vectors, for the serial engines
+  vector <vector<int> > BuildGraph(const vector <pair<int, int> > &edges,
+                                   bool simplify = false, int64_t *dropped = NULL);
+
+  // Sorts every neighbor list in parallel and removes its self loops and
+  // repeated edges, none of which change a distance. Returns how many edges
+  // went.
+  int64_t SimplifyGraph(pvector <pvector<int> > &adjlist);
+  int64_t SimplifyGraph(vector <vector<int> > &adjlist);
+
+  // A weighted graph is an adjlist as above plus, for every list, the
+  // weights of its edges in the same order, so everything structural (SCCs,
+  // transpose, vertex order) is shared with the unweighted engines.
+  // With simplify, self loops go and only the lightest of repeated edges
+  // stays; dropped is set as for BuildTSGraph.
+  void BuildWeightedGraph(const vector<Generator::WeightedEdge> &edges,
+                          pvector <pvector<int> > &adjlist,
+                          pvector <pvector<int> > &weights,
+                          bool simplify = false, int64_t *dropped = NULL);
+
+  // Weighted diameter (largest finite distance) by the same SCC and
+  // eccentricity-bound pruning as GetFastDiamParallel, with a parallel
+  // delta-stepping SSSP in place of the BFS. A delta of 0 picks one from
+  // the weights and degrees. sweeps as for GetFastDiam.
+  int64_t GetFastDiamWeighted(const pvector <pvector<int> > &adjlist,
+                              const pvector <pvector<int> > &weights, int64_t delta = 0,
+                              const SweepOptions &sweeps = kDefaultSweeps);
 
 } // end namespace Diameter
 # endif
@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cstdint>
+#include <omp.h>
+#include <parallel/algorithm>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "graphgen.h"
+
+using namespace std;
+
+namespace {
+  // Edges drawn from a single seeded generator, same blocking as GAP's
+  // generator so the graph is identical for any number of threads.
+  const size_t kBlockSize = 1 << 18;
+
+  // R-MAT quadrant probabilities (Graph500 / GAP defaults), D = 1 - A - B - C
+  const double kA = 0.57, kB = 0.19, kC = 0.19;
+
+  // Random relabeling so the R-MAT hubs are not all packed at low IDs
+  void Permute(vector <pair<int, int> > &edges, int num_nodes, uint64_t seed) {
+    vector<int> perm(num_nodes);
+    #pragma omp parallel for
+    for (int n = 0; n < num_nodes; n++) perm[n] = n;
+    mt19937_64 rng(seed);
+    shuffle(perm.begin(), perm.end(), rng);
+
+    #pragma omp parallel for
+    for (size_t e = 0; e < edges.size(); e++) {
+      edges[e] = make_pair(perm[edges[e].first], perm[edges[e].second]);
+    }
+  }
+
+  template <typename ID>
+  bool Compact(const vector <pair<ID, ID> > &raw, vector <pair<int, int> > &edges,
+               Generator::IdMap &ids) {
+    size_t num_edges = raw.size();
+    vector<int64_t> &original = ids.original;
+    original.resize(2 * num_edges);
+    #pragma omp parallel for
+    for (size_t e = 0; e < num_edges; e++) {
+      original[2 * e] = raw[e].first;
+      original[2 * e + 1] = raw[e].second;
+    }
+    __gnu_parallel::sort(original.begin(), original.end());
+    original.erase(unique(original.begin(), original.end()), original.end());
+    original.shrink_to_fit();
+    if (original.size() >= (size_t)INT32_MAX) return false;
+
+    edges.resize(num_edges);
+    #pragma omp parallel for
+    for (size_t e = 0; e < num_edges; e++) {
+      int from = lower_bound(original.begin(), original.end(), (int64_t)raw[e].first) - original.begin();
+      int to = lower_bound(original.begin(), original.end(), (int64_t)raw[e].second) - original.begin();
+      edges[e] = make_pair(from, to);
+    }
+    return true;
+  }
+} // end namespace
+
+namespace Generator {
+  bool ParseKind(const string &name, GenKind &kind) {
+    if (name == "rmat" || name == "kron") kind = GEN_RMAT;
+    else if (name == "er") kind = GEN_ER;
+    else if (name == "grid") kind = GEN_GRID;
+    else if (name == "path") kind = GEN_PATH;
+    else if (name == "star") kind = GEN_STAR;
+    else if (name == "maximal") kind = GEN_MAXIMAL;
+    else return false;
+    return true;
+  }
+
+  vector <pair<int, int> > Generate(GenKind kind, int scale, int degree,
+                                    uint64_t seed) {
+    if (scale < 0 || scale > kMaxScale) return vector <pair<int, int> >();
+    int64_t num_nodes = int64_t(1) << scale;
+    switch (kind) {
+      case GEN_RMAT:
+        return GenRMAT(scale, degree, seed);
+      case GEN_ER:
+        return GenErdosRenyi(num_nodes, degree, seed);
+      case GEN_GRID:
+        return GenGrid(1 << (scale / 2), 1 << (scale - scale / 2));
+      case GEN_PATH:
+        return GenPath(num_nodes - 1);
+      case GEN_STAR:
+        return GenStar(num_nodes / 2);
+      case GEN_MAXIMAL:
+        return GenMaximal(num_nodes);
+      default:
+        return vector <pair<int, int> >();
+    }
+  }
+
+  vector <pair<int, int> > GenRMAT(int scale, int degree, uint64_t seed) {
+    int num_nodes = 1 << scale;
+    size_t num_edges = (size_t)num_nodes * degree;
+    vector <pair<int, int> > edges(num_edges);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t block = 0; block < num_edges; block += kBlockSize) {
+      mt19937_64 rng(seed + block / kBlockSize);
+      uniform_real_distribution<double> udist(0, 1);
+      size_t block_end = min(block + kBlockSize, num_edges);
+
+      for (size_t e = block; e < block_end; e++) {
+        int from = 0, to = 0;
+        for (int depth = 0; depth < scale; depth++) {
+          double r = udist(rng);
+          from <<= 1;
+          to <<= 1;
+          if (r < kA) continue;
+          if (r < kA + kB) to |= 1;
+          else if (r < kA + kB + kC) from |= 1;
+          else {
+            from |= 1;
+            to |= 1;
+          }
+        }
+        edges[e] = make_pair(from, to);
+      }
+    }
+    Permute(edges, num_nodes, seed);
+    return edges;
+  }
+
+  vector <pair<int, int> > GenErdosRenyi(int num_nodes, int degree, uint64_t seed) {
+    size_t num_edges = (size_t)num_nodes * degree;
+    vector <pair<int, int> > edges(num_edges);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t block = 0; block < num_edges; block += kBlockSize) {
+      mt19937_64 rng(seed + block / kBlockSize);
+      uniform_int_distribution<int> udist(0, num_nodes - 1);
+      size_t block_end = min(block + kBlockSize, num_edges);
+
+      for (size_t e = block; e < block_end; e++) {
+        int from = udist(rng);
+        edges[e] = make_pair(from, udist(rng));
+      }
+    }
+    return edges;
+  }
+
+  vector <pair<int, int> > GenGrid(int rows, int cols) {
+    // Each node owns the edges to its right and lower neighbors, both ways
+    size_t horizontal = (size_t)rows * (cols - 1);
+    size_t vertical = (size_t)(rows - 1) * cols;
+    vector <pair<int, int> > edges(2 * (horizontal + vertical));
+
+    #pragma omp parallel for
+    for (int r = 0; r < rows; r++) {
+      size_t h = 2 * (size_t)r * (cols - 1);
+      for (int c = 0; c + 1 < cols; c++) {
+        int u = r * cols + c;
+        edges[h++] = make_pair(u, u + 1);
+        edges[h++] = make_pair(u + 1, u);
+      }
+      if (r + 1 < rows) {
+        size_t v = 2 * (horizontal + (size_t)r * cols);
+        for (int c = 0; c < cols; c++) {
+          int u = r * cols + c;
+          edges[v++] = make_pair(u, u + cols);
+          edges[v++] = make_pair(u + cols, u);
+        }
+      }
+    }
+    return edges;
+  }
+
+  vector <pair<int, int> > GenPath(int pathlen) {
+    vector <pair<int, int> > edges(pathlen);
+
+    #pragma omp parallel for
+    for (int i = 0; i < pathlen; i++) {
+      edges[i] = make_pair(i, i + 1);
+    }
+    return edges;
+  }
+
+  vector <pair<int, int> > GenStar(int starsize) {
+    size_t clique = (size_t)starsize * (starsize - 1);
+    vector <pair<int, int> > edges(clique + (size_t)starsize * starsize);
+
+    #pragma omp parallel for
+    for (int i = 0; i < starsize; i++) {
+      size_t e = (size_t)i * (starsize - 1);
+      for (int j = 0; j < starsize; j++) {
+        if (i != j) {
+          edges[e++] = make_pair(i, j);
+        }
+      }
+      // connect every "angle" node to every edge in the maximal subgraph
+      e = clique + (size_t)i * starsize;
+      for (int j = 0; j < starsize; j++) {
+        edges[e++] = make_pair(starsize + i, j);
+      }
+    }
+    return edges;
+  }
+
+  vector <pair<int, int> > GenMaximal(int size) {
+    vector <pair<int, int> > edges((size_t)size * (size - 1));
+
+    #pragma omp parallel for
+    for (int i = 0; i < size; i++) {
+      size_t e = (size_t)i * (size - 1);
+      for (int j = 0; j < size; j++) {
+        if (i != j) {
+          edges[e++] = make_pair(i, j);
+        }
+      }
+    }
+    return edges;
+  }
+
+  void Symmetrize(vector <pair<int, int> > &edges) {
+    size_t num_edges = edges.size();
+    edges.resize(2 * num_edges);
+
+    #pragma omp parallel for
+    for (size_t e = 0; e < num_edges; e++) {
+      edges[num_edges + e] = make_pair(edges[e].second, edges[e].first);
+    }
+  }
+
+  int64_t SimplifyEdges(vector <pair<int, int> > &edges) {
+    size_t num_edges = edges.size();
+    __gnu_parallel::sort(edges.begin(), edges.end());
+    auto last = unique(edges.begin(), edges.end());
+    last = remove_if(edges.begin(), last, [](const pair<int, int> &edge) {
+      return edge.first == edge.second;
+    });
+    edges.resize(last - edges.begin());
+    return num_edges - edges.size();
+  }
+
+  vector<WeightedEdge> AddRandomWeights(const vector <pair<int, int> > &edges,
+                                        int max_weight, uint64_t seed) {
+    size_t num_edges = edges.size();
+    vector<WeightedEdge> weighted(num_edges);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t block = 0; block < num_edges; block += kBlockSize) {
+      mt19937_64 rng(seed + block / kBlockSize);
+      uniform_int_distribution<int> udist(1, max_weight);
+      size_t block_end = min(block + kBlockSize, num_edges);
+
+      for (size_t e = block; e < block_end; e++) {
+        weighted[e].from = edges[e].first;
+        weighted[e].to = edges[e].second;
+        weighted[e].weight = udist(rng);
+      }
+    }
+    return weighted;
+  }
+
+  bool ReadWeightedEdges(const char *filename, vector<WeightedEdge> &edges) {
+    FILE *in = fopen(filename, "r");
+    if (in == NULL) return false;
+
+    WeightedEdge edge;
+    while (fscanf(in, "%d %d %d", &edge.from, &edge.to, &edge.weight) == 3) {
+      if (edge.from < 0 || edge.to < 0 || edge.weight < 0) {
+        fclose(in);
+        return false;
+      }
+      edges.push_back(edge);
+    }
+    fclose(in);
+    return true;
+  }
+
+  bool ReadWeightedEdges64(const char *filename, vector <pair<int64_t, int64_t> > &edges,
+                           vector<int> &weights) {
+    FILE *in = fopen(filename, "r");
+    if (in == NULL) return false;
+
+    long long from, to;
+    int weight;
+    while (fscanf(in, "%lld %lld %d", &from, &to, &weight) == 3) {
+      if (from < 0 || to < 0 || weight < 0) {
+        fclose(in);
+        return false;
+      }
+      edges.push_back(make_pair((int64_t)from, (int64_t)to));
+      weights.push_back(weight);
+    }
+    fclose(in);
+    return true;
+  }
+
+  void Symmetrize(vector<WeightedEdge> &edges) {
+    size_t num_edges = edges.size();
+    edges.resize(2 * num_edges);
+
+    #pragma omp parallel for
+    for (size_t e = 0; e < num_edges; e++) {
+      WeightedEdge reverse = {edges[e].to, edges[e].from, edges[e].weight};
+      edges[num_edges + e] = reverse;
+    }
+  }
+
+  bool WriteBinaryEdges(const char *filename, const vector <pair<int, int> > &edges) {
+    FILE *out = fopen(filename, "wb");
+    if (out == NULL) return false;
+
+    int64_t num_edges = edges.size();
+    bool ok = fwrite(&num_edges, sizeof(num_edges), 1, out) == 1 &&
+              fwrite(edges.data(), sizeof(pair<int, int>), num_edges, out) == (size_t)num_edges;
+    fclose(out);
+    return ok;
+  }
+
+  bool ReadBinaryEdges(const char *filename, vector <pair<int, int> > &edges) {
+    FILE *in = fopen(filename, "rb");
+    if (in == NULL) return false;
+
+    int64_t num_edges = 0;
+    bool ok = fread(&num_edges, sizeof(num_edges), 1, in) == 1 && num_edges >= 0;
+    if (ok) {
+      edges.resize(num_edges);
+      ok = fread(edges.data(), sizeof(pair<int, int>), num_edges, in) == (size_t)num_edges;
+    }
+    fclose(in);
+    // IDs index the adjacency lists
+    for (size_t i = 0; ok && i < edges.size(); i++) {
+      ok = edges[i].first >= 0 && edges[i].second >= 0;
+    }
+    return ok;
+  }
+
+  bool ReadTextEdges64(const char *filename, vector <pair<int64_t, int64_t> > &edges) {
+    FILE *in = fopen(filename, "r");
+    if (in == NULL) return false;
+
+    for (long long from, to; fscanf(in, "%lld %lld", &from, &to) == 2; ) {
+      edges.push_back(make_pair((int64_t)from, (int64_t)to));
+    }
+    fclose(in);
+    return true;
+  }
+
+  bool IdMap::ToDense(int64_t id, int num_vertices, int &v) const {
+    if (original.empty()) {
+      v = id;
+      return id >= 0 && id < num_vertices;
+    }
+    vector<int64_t>::const_iterator it = lower_bound(original.begin(), original.end(), id);
+    if (it == original.end() || *it != id) return false;
+    v = it - original.begin();
+    return true;
+  }
+
+  bool CompactIDs(const vector <pair<int64_t, int64_t> > &raw,
+                  vector <pair<int, int> > &edges, IdMap &ids) {
+    return Compact(raw, edges, ids);
+  }
+
+  bool CompactIDs(vector <pair<int, int> > &edges, IdMap &ids) {
+    return Compact(edges, edges, ids);
+  }
+
+  bool CompactIDs(const vector <pair<int64_t, int64_t> > &raw, const vector<int> &weights,
+                  vector<WeightedEdge> &edges, IdMap &ids) {
+    vector <pair<int, int> > dense;
+    if (!Compact(raw, dense, ids)) return false;
+    edges.resize(dense.size());
+    #pragma omp parallel for
+    for (size_t e = 0; e < dense.size(); e++) {
+      WeightedEdge edge = {dense[e].first, dense[e].second, weights[e]};
+      edges[e] = edge;
+    }
+    return true;
+  }
+} // end namespace Generator
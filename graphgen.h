@@ -0,0 +1,105 @@
+# ifndef GRAPHGEN_H
+# define GRAPHGEN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Generator {
+  // Shapes selectable from the tester with --gen
+  enum GenKind {GEN_RMAT, GEN_ER, GEN_GRID, GEN_PATH, GEN_STAR, GEN_MAXIMAL};
+
+  bool ParseKind(const string &name, GenKind &kind);
+
+  // Largest scale whose vertex IDs still fit in an int
+  const int kMaxScale = 30;
+
+  // Builds the edge list of a graph of the given kind with 2^scale vertices,
+  // empty for a scale outside [0, kMaxScale].
+  // Every generator fills its edges in parallel; random ones seed their
+  // generators per block of edges so output does not depend on thread count.
+  vector <pair<int, int> > Generate(GenKind kind, int scale, int degree,
+                                    uint64_t seed);
+
+  // R-MAT (Kronecker) graph with 2^scale vertices and degree * 2^scale edges
+  vector <pair<int, int> > GenRMAT(int scale, int degree, uint64_t seed);
+
+  // Erdős–Rényi G(n, m) graph with m = degree * n uniformly random edges
+  vector <pair<int, int> > GenErdosRenyi(int num_nodes, int degree, uint64_t seed);
+
+  // rows x cols lattice, every edge in both directions
+  vector <pair<int, int> > GenGrid(int rows, int cols);
+
+  // 0 --> 1 --> ... --> pathlen
+  vector <pair<int, int> > GenPath(int pathlen);
+
+  // Complete graph on starsize nodes plus starsize "angle" nodes pointing
+  // at every node of the complete graph
+  vector <pair<int, int> > GenStar(int starsize);
+
+  // Complete directed graph on size nodes
+  vector <pair<int, int> > GenMaximal(int size);
+
+  // Appends the reverse of every edge
+  void Symmetrize(vector <pair<int, int> > &edges);
+
+  // Sorts the edges and removes self loops and repeats, as
+  // Diameter::SimplifyGraph does to lists. Returns how many edges went.
+  int64_t SimplifyEdges(vector <pair<int, int> > &edges);
+
+  // Binary edge list: a 64-bit edge count followed by (from, to) int pairs
+  bool WriteBinaryEdges(const char *filename, const vector <pair<int, int> > &edges);
+
+  // Fails on a short file or a negative ID
+  bool ReadBinaryEdges(const char *filename, vector <pair<int, int> > &edges);
+
+  // Edge of a weighted graph; weights are non-negative
+  struct WeightedEdge {
+    int from, to, weight;
+  };
+
+  // Uniform weights in [1, max_weight], seeded per block like the generators
+  vector<WeightedEdge> AddRandomWeights(const vector <pair<int, int> > &edges,
+                                        int max_weight, uint64_t seed);
+
+  // Text "from to weight" triples; fails on a negative ID or weight
+  bool ReadWeightedEdges(const char *filename, vector<WeightedEdge> &edges);
+
+  // Same, with IDs of up to 64 bits, for CompactIDs; weights apart
+  bool ReadWeightedEdges64(const char *filename, vector <pair<int64_t, int64_t> > &edges,
+                           vector<int> &weights);
+
+  // Appends the reverse of every edge, with the same weight
+  void Symmetrize(vector<WeightedEdge> &edges);
+
+  // Text edge list whose IDs may take up to 64 bits
+  bool ReadTextEdges64(const char *filename, vector <pair<int64_t, int64_t> > &edges);
+
+  // Original ID of every vertex of a compacted graph. IDs are numbered in
+  // increasing order, so the map is sorted and looked up by binary search;
+  // empty means IDs were not compacted and map to themselves.
+  struct IdMap {
+    vector<int64_t> original;
+
+    int64_t ToOriginal(int v) const { return original.empty() ? v : original[v]; }
+
+    // False if id is not a vertex of the graph of num_vertices vertices
+    bool ToDense(int64_t id, int num_vertices, int &v) const;
+  };
+
+  // Relabels the endpoints of raw to the dense range [0, n) of the distinct
+  // IDs present, by a parallel sort of all endpoints, and returns the map
+  // back. False if there are 2^31 or more distinct IDs.
+  bool CompactIDs(const vector <pair<int64_t, int64_t> > &raw,
+                  vector <pair<int, int> > &edges, IdMap &ids);
+
+  // Same, in place on 32-bit IDs
+  bool CompactIDs(vector <pair<int, int> > &edges, IdMap &ids);
+
+  // Same, for weighted edges: edge e gets weights[e]
+  bool CompactIDs(const vector <pair<int64_t, int64_t> > &raw, const vector<int> &weights,
+                  vector<WeightedEdge> &edges, IdMap &ids);
+} // end namespace Generator
+# endif
@@ -0,0 +1,31 @@
+# ifndef KERNELS_H
+# define KERNELS_H
+
+#include <cstdint>
+#include "ForParallelFromBeamer/bitmap.h"
+#include "ForParallelFromBeamer/pvector.h"
+#include "ForParallelFromBeamer/sliding_queue.h"
+
+using namespace std;
+
+// The self-contained BFS kernels of diamrallel.cc, each opening a parallel
+// region of its own, for callers that time them one by one. Distances are
+// -1 for unvisited vertices.
+namespace Parallel {
+  // One bottom-up level: every unvisited vertex with a parent in queue gets
+  // its distance and a bit in next, which is reset first. Returns how many.
+  int BottomUp(const pvector <pvector<int> > &radjlist, pvector<int> &distance,
+               Bitmap &queue, Bitmap &next);
+
+  // One top-down level from the window of queue, pushing the new frontier
+  // for the caller to slide in. Returns the number of edges leaving it.
+  int64_t TopDown(const pvector <pvector<int> > &adjlist, pvector<int> &distance,
+                  SlidingQueue<int> &queue);
+
+  void QueueToBitmap(const SlidingQueue<int> &queue, Bitmap &bm);
+
+  // Replaces queue with the vertices set in bm
+  void BitmapToQueue(const pvector <pvector<int> > &adjlist, const Bitmap &bm,
+                     SlidingQueue<int> &queue);
+} // end namespace Parallel
+# endif
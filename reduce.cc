@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <parallel/algorithm>
+#include <vector>
+#include "reduce.h"
+
+using namespace std;
+
+namespace {
+  // Sorted, duplicate-free neighbors without self loops, which change no
+  // distance but would hide a leaf
+  vector <vector<int> > BuildSimpleAdjlist(const vector <pair<int, int> > &edges,
+                                           bool reverse = false) {
+    int max_node = 0;
+    for (pair<int, int> edge : edges) {
+      max_node = max({max_node, edge.first + 1, edge.second + 1});
+    }
+    vector <vector<int> > adjlist(max_node);
+    for (pair<int, int> edge : edges) {
+      if (edge.first == edge.second) continue;
+      if (reverse) adjlist[edge.second].push_back(edge.first);
+      else adjlist[edge.first].push_back(edge.second);
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int v = 0; v < max_node; v++) {
+      sort(adjlist[v].begin(), adjlist[v].end());
+      adjlist[v].erase(unique(adjlist[v].begin(), adjlist[v].end()), adjlist[v].end());
+    }
+    return adjlist;
+  }
+
+  bool IsSymmetric(const vector <vector<int> > &adjlist) {
+    int V = adjlist.size();
+    bool symmetric = true;
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(& : symmetric)
+    for (int u = 0; u < V; u++) {
+      for (int v : adjlist[u]) {
+        symmetric &= binary_search(adjlist[v].begin(), adjlist[v].end(), u);
+      }
+    }
+    return symmetric;
+  }
+
+  // Appends a path of length edges from start in both directions, its new
+  // vertices numbered from next on
+  void AppendPath(int start, int length, int &next, vector <pair<int, int> > &edges) {
+    for (int prev = start, i = 0; i < length; i++, prev = next++) {
+      edges.push_back(make_pair(prev, next));
+      edges.push_back(make_pair(next, prev));
+    }
+  }
+
+  uint64_t Mix(uint64_t z) {
+      z += 0x9E3779B97F4A7C15ULL;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+  }
+
+  // Order-free hash of a neighbor set, salted apart for out and in
+  uint64_t HashSet(const vector<int> &set, int self, bool closed, uint64_t salt) {
+    uint64_t hash = 0;
+    for (int v : set) hash += Mix(v ^ salt);
+    if (closed) hash += Mix(self ^ salt);
+    return hash;
+  }
+
+  // a + {u} == b + {v} if closed, a == b otherwise. Neither list holds its
+  // own vertex, so closed twins must list each other and agree on the rest.
+  bool SameSet(const vector<int> &a, int u, const vector<int> &b, int v, bool closed) {
+    if (!closed) return a == b;
+    if (a.size() != b.size() || !binary_search(a.begin(), a.end(), v) ||
+        !binary_search(b.begin(), b.end(), u)) {
+      return false;
+    }
+    for (size_t i = 0, j = 0; ; ) {
+      if (i < a.size() && a[i] == v) i++;
+      if (j < b.size() && b[j] == u) j++;
+      if (i == a.size() || j == b.size()) return i == a.size() && j == b.size();
+      if (a[i++] != b[j++]) return false;
+    }
+  }
+
+  // Length of the shortest cycle through source, or -1 if there is none
+  int ShortestCycle(const vector <vector<int> > &adjlist, const vector <vector<int> > &radjlist,
+                    int source, vector<int> &dist, vector<int> &queue) {
+    int length = -1;
+    size_t head = 0, tail = 0;
+    dist[source] = 0;
+    queue[tail++] = source;
+    while (head < tail && length < 0) {
+      int u = queue[head++];
+      for (int v : adjlist[u]) {
+        if (dist[v] >= 0) continue;
+        dist[v] = dist[u] + 1;
+        queue[tail++] = v;
+        if (binary_search(radjlist[source].begin(), radjlist[source].end(), v)) {
+          length = dist[v] + 1;
+          break;
+        }
+      }
+    }
+    for (size_t i = 0; i < tail; i++) dist[queue[i]] = -1;
+    return length;
+  }
+
+  // One round of MergeTwins over open or closed neighborhoods
+  vector <pair<int, int> > MergeTwinClasses(const vector <pair<int, int> > &edges, bool closed,
+                                            Diameter::TwinStats &stats) {
+    vector <vector<int> > adjlist = BuildSimpleAdjlist(edges);
+    vector <vector<int> > radjlist = BuildSimpleAdjlist(edges, true);
+    int V = adjlist.size();
+
+    // Twins hash alike, so only vertices in a run of one hash are compared
+    vector <pair<uint64_t, int> > hashed(V);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int v = 0; v < V; v++) {
+      uint64_t hash = HashSet(adjlist[v], v, closed, 0) ^
+                      Mix(HashSet(radjlist[v], v, closed, 0x5BD1E995));
+      hashed[v] = make_pair(hash, v);
+    }
+    __gnu_parallel::sort(hashed.begin(), hashed.end());
+
+    vector<int> rep(V);
+    for (int v = 0; v < V; v++) rep[v] = v;
+    vector<char> multiple(V, false); // set concurrently, so not vector<bool>
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int start = 0; start < V; start++) {
+      if (start > 0 && hashed[start - 1].first == hashed[start].first) continue;
+      int end = start + 1;
+      while (end < V && hashed[end].first == hashed[start].first) end++;
+      // colliding classes are told apart by comparing against each earlier rep
+      for (int i = start + 1; i < end; i++) {
+        int v = hashed[i].second;
+        for (int j = start; j < i; j++) {
+          int u = hashed[j].second;
+          if (rep[u] == u && SameSet(adjlist[u], u, adjlist[v], v, closed) &&
+              SameSet(radjlist[u], u, radjlist[v], v, closed)) {
+            rep[v] = u;
+            multiple[u] = true;
+            break;
+          }
+        }
+      }
+    }
+
+    vector<int> label(V, -1);
+    int next = 0;
+    for (int v = 0; v < V; v++) {
+      if (rep[v] == v) label[v] = next++;
+      else stats.merged++;
+    }
+
+    // A rep's edges stand for its whole class
+    vector <vector<int> > quotient(next), rquotient(next);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int v = 0; v < V; v++) {
+      if (rep[v] != v) continue;
+      for (int w : adjlist[v]) {
+        if (rep[w] != v) quotient[label[v]].push_back(label[rep[w]]);
+      }
+      for (int w : radjlist[v]) {
+        if (rep[w] != v) rquotient[label[v]].push_back(label[rep[w]]);
+      }
+      for (vector<int> *list : {&quotient[label[v]], &rquotient[label[v]]}) {
+        sort(list->begin(), list->end());
+        list->erase(unique(list->begin(), list->end()), list->end());
+      }
+    }
+
+    // True twins are adjacent. False twins u, v are as far apart as the
+    // shortest cycle through either, as u -> w reaches v wherever it reaches u.
+    int twin_distance = 0, classes = 0;
+    #pragma omp parallel reduction(max : twin_distance) reduction(+ : classes)
+    {
+      vector<int> dist(next, -1), queue(next);
+      #pragma omp for schedule(dynamic, 64)
+      for (int v = 0; v < V; v++) {
+        if (!multiple[v]) continue;
+        classes++;
+        if (closed) {
+          twin_distance = max(twin_distance, 1);
+        } else {
+          twin_distance = max(twin_distance,
+                              ShortestCycle(quotient, rquotient, label[v], dist, queue));
+        }
+      }
+    }
+    stats.classes += classes;
+    stats.twin_distance = max(stats.twin_distance, twin_distance);
+
+    vector <pair<int, int> > reduced;
+    for (int u = 0; u < next; u++) {
+      for (int v : quotient[u]) reduced.push_back(make_pair(u, v));
+    }
+    return reduced;
+  }
+} // end namespace
+
+namespace Diameter {
+  bool PeelWhiskers(const vector <pair<int, int> > &edges, vector <pair<int, int> > &reduced,
+                    vector<int> &core_depth, PeelStats &stats) {
+    vector <vector<int> > adjlist = BuildSimpleAdjlist(edges);
+    if (!IsSymmetric(adjlist)) return false;
+    int V = adjlist.size();
+
+    // Peel leaves until only vertices on cycles, or between two of them, are
+    // left. depth is the height of the trees peeled into a vertex so far.
+    vector<int> degree(V), depth(V, 0);
+    vector<bool> peeled(V, false);
+    deque<int> leaves;
+    for (int v = 0; v < V; v++) {
+      degree[v] = adjlist[v].size();
+      if (degree[v] == 1) leaves.push_back(v);
+    }
+    int tree_diameter = 0, num_peeled = 0;
+    while (!leaves.empty()) {
+      int v = leaves.front();
+      leaves.pop_front();
+      // the last vertex of a tree component stays as its root
+      if (degree[v] != 1) continue;
+
+      int parent = -1;
+      for (int w : adjlist[v]) {
+        if (!peeled[w]) {
+          parent = w;
+          break;
+        }
+      }
+      peeled[v] = true;
+      num_peeled++;
+      degree[v] = 0;
+
+      // A path through parent joins its deepest branch so far with this one
+      tree_diameter = max(tree_diameter, depth[parent] + depth[v] + 1);
+      depth[parent] = max(depth[parent], depth[v] + 1);
+      if (--degree[parent] == 1) leaves.push_back(parent);
+    }
+
+    // Renumber the core. Isolated vertices, the roots of whole trees among
+    // them, have no distances beyond tree_diameter to keep.
+    vector<int> label(V, -1);
+    int num_core = 0;
+    for (int v = 0; v < V; v++) {
+      if (!peeled[v] && degree[v] > 0) label[v] = num_core++;
+    }
+
+    reduced.clear();
+    core_depth.assign(num_core, 0);
+    for (int u = 0; u < V; u++) {
+      if (label[u] < 0) continue;
+      core_depth[label[u]] = depth[u];
+      for (int v : adjlist[u]) {
+        if (!peeled[v]) reduced.push_back(make_pair(label[u], label[v]));
+      }
+    }
+
+    stats.peeled = num_peeled;
+    stats.core = num_core;
+    stats.tree_diameter = tree_diameter;
+    return true;
+  }
+
+  void MergeTwins(const vector <pair<int, int> > &edges, vector <pair<int, int> > &reduced,
+                  TwinStats &stats) {
+    stats.merged = stats.classes = stats.twin_distance = 0;
+    reduced = MergeTwinClasses(MergeTwinClasses(edges, false, stats), true, stats);
+    if (stats.twin_distance > 0) {
+      int next = 0;
+      for (pair<int, int> edge : reduced) next = max({next, edge.first + 1, edge.second + 1});
+      int start = next++;
+      AppendPath(start, stats.twin_distance, next, reduced);
+    }
+  }
+} // end namespace Diameter
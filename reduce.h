@@ -0,0 +1,41 @@
+# ifndef REDUCE_H
+# define REDUCE_H
+
+#include <vector>
+
+using namespace std;
+
+namespace Diameter {
+  struct PeelStats {
+    int peeled;         // whisker vertices removed
+    int core;           // vertices left that no whisker reduces
+    int tree_diameter;  // longest path with both ends in one whisker tree
+  };
+
+  // Reduction of an undirected graph (every edge given in both directions).
+  // Pendant trees, pendant chains included, are peeled leaf by leaf into the
+  // depth of their deepest leaf below the core vertex they hang from.
+  // reduced is the core, renumbered, and depth holds each core vertex's
+  // attachment depth, for the engines that take one. The original diameter
+  // is the larger of theirs on the core and tree_diameter, which covers the
+  // paths that never leave the trees of one vertex. Returns false, leaving
+  // reduced and depth alone, if the graph is directed.
+  bool PeelWhiskers(const vector <pair<int, int> > &edges, vector <pair<int, int> > &reduced,
+                    vector<int> &depth, PeelStats &stats);
+
+  struct TwinStats {
+    int merged;         // vertices folded into a twin
+    int classes;        // twin classes of two or more vertices
+    int twin_distance;  // longest finite distance between two twins
+  };
+
+  // Diameter-preserving reduction of any graph by structural twins: vertices
+  // with the same out- and in-neighbors (false twins), then the same ones
+  // counting themselves (true twins, as in a clique), are equally far from
+  // everything else, so each class collapses into one vertex. Only the
+  // distances within a class are lost; the longest is kept as a path of its
+  // own in reduced, as PeelWhiskers does with its trees.
+  void MergeTwins(const vector <pair<int, int> > &edges, vector <pair<int, int> > &reduced,
+                  TwinStats &stats);
+} // end namespace Diameter
+# endif
@@ -0,0 +1,698 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <limits>
+#include <omp.h>
+#include <stdio.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "ForParallelFromBeamer/platform_atomics.h"
+#include "ForParallelFromBeamer/pvector.h"
+#include "ForParallelFromBeamer/sliding_queue.h"
+#include "semiext.h"
+
+using namespace std;
+
+namespace {
+  // File layout: magic, V, E, forward offsets (V + 1), reverse offsets
+  // (V + 1), forward neighbors (E), reverse neighbors (E)
+  const char kMagic[8] = {'D', 'I', 'A', 'M', 'C', 'S', 'R', '1'};
+  const int64_t kHeaderSize = sizeof(kMagic) + 2 * sizeof(int64_t);
+
+  // Vertices per streamed block; the lists of the next block are prefetched
+  // while one is being processed
+  const int kStreamBlock = 1 << 16;
+
+  // Direction switch, same rule as the in-memory engine
+  const int kAlpha = 15, kBeta = 18;
+
+  const size_t kEdgeChunk = 1 << 20;
+
+  typedef function<void(const pair<int, int> *, size_t)> EdgeVisitor;
+
+  // Read-only mapping of a disk CSR. Pages are only brought in as lists are
+  // touched and, being clean, can be dropped again under memory pressure.
+  class DiskGraph {
+   public:
+    DiskGraph() : base_(NULL), size_(0), V_(0), E_(0) {}
+
+    ~DiskGraph() {
+      if (base_ != NULL) munmap(base_, size_);
+    }
+
+    bool Open(const char *filename) {
+      int fd = open(filename, O_RDONLY);
+      if (fd < 0) return false;
+      struct stat st;
+      if (fstat(fd, &st) != 0 || st.st_size < kHeaderSize) {
+        close(fd);
+        return false;
+      }
+      size_ = st.st_size;
+      void *base = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+      if (base == MAP_FAILED) return false;
+      base_ = static_cast<char *>(base);
+
+      const int64_t *header = reinterpret_cast<const int64_t *>(base_ + sizeof(kMagic));
+      V_ = header[0];
+      E_ = header[1];
+      if (memcmp(base_, kMagic, sizeof(kMagic)) != 0 ||
+          (size_t)(kHeaderSize + 2 * (V_ + 1) * sizeof(int64_t) + 2 * E_ * sizeof(int)) != size_) {
+        return false;
+      }
+      offsets_[0] = reinterpret_cast<const int64_t *>(base_ + kHeaderSize);
+      offsets_[1] = offsets_[0] + V_ + 1;
+      neighbors_[0] = reinterpret_cast<const int *>(offsets_[1] + V_ + 1);
+      neighbors_[1] = neighbors_[0] + E_;
+      return true;
+    }
+
+    int64_t num_vertices() const { return V_; }
+    int64_t num_edges() const { return E_; }
+
+    // Out-neighbors of v, or in-neighbors when reverse
+    const int *begin(int v, bool reverse) const {
+      return neighbors_[reverse] + offsets_[reverse][v];
+    }
+
+    const int *end(int v, bool reverse) const {
+      return neighbors_[reverse] + offsets_[reverse][v + 1];
+    }
+
+    int64_t degree(int v, bool reverse) const {
+      return offsets_[reverse][v + 1] - offsets_[reverse][v];
+    }
+
+    // Starts kernel readahead of the lists of [first, last)
+    void Prefetch(int64_t first, int64_t last, bool reverse) const {
+      if (first >= last) return;
+      Advise(offsets_[reverse] + first, offsets_[reverse] + last + 1);
+      Advise(begin(first, reverse), begin(last, reverse));
+    }
+
+   private:
+    char *base_;
+    size_t size_;
+    int64_t V_, E_;
+    const int64_t *offsets_[2];
+    const int *neighbors_[2];
+
+    static void Advise(const void *first, const void *last) {
+      static const uintptr_t page = sysconf(_SC_PAGESIZE);
+      uintptr_t start = reinterpret_cast<uintptr_t>(first) & ~(page - 1);
+      uintptr_t stop = reinterpret_cast<uintptr_t>(last);
+      if (stop > start) madvise(reinterpret_cast<void *>(start), stop - start, MADV_WILLNEED);
+    }
+  };
+
+  // Streams an edge file to visit in chunks. Fails on a short file or a
+  // negative ID, before any of that chunk is visited.
+  bool ForEachEdgeChunk(const char *filename, const EdgeVisitor &visit) {
+    string name = filename;
+    bool binary = name.size() >= 4 && name.compare(name.size() - 4, 4, ".bin") == 0;
+    FILE *in = fopen(filename, binary ? "rb" : "r");
+    if (in == NULL) return false;
+
+    vector <pair<int, int> > chunk(kEdgeChunk);
+    bool ok = true;
+    if (binary) {
+      int64_t remaining = 0;
+      ok = fread(&remaining, sizeof(remaining), 1, in) == 1;
+      while (ok && remaining > 0) {
+        size_t count = min<int64_t>(remaining, kEdgeChunk);
+        ok = fread(chunk.data(), sizeof(pair<int, int>), count, in) == count;
+        for (size_t e = 0; ok && e < count; e++) {
+          ok = chunk[e].first >= 0 && chunk[e].second >= 0;
+        }
+        if (ok) visit(chunk.data(), count);
+        remaining -= count;
+      }
+    } else {
+      size_t count = 0;
+      for (int from, to; fscanf(in, "%d %d", &from, &to) == 2; ) {
+        if (from < 0 || to < 0) {
+          ok = false;
+          break;
+        }
+        chunk[count++] = make_pair(from, to);
+        if (count == kEdgeChunk) {
+          visit(chunk.data(), count);
+          count = 0;
+        }
+      }
+      if (ok) visit(chunk.data(), count);
+    }
+    fclose(in);
+    return ok;
+  }
+
+  // Two passes over the edges: count degrees, then place every edge in both
+  // the forward and the reverse lists of the mmapped output.
+  bool WriteDiskCSR(const char *csr_file, const function<bool(const EdgeVisitor &)> &for_each_chunk) {
+    vector<int64_t> out_cursor, in_cursor;
+    int64_t num_edges = 0;
+    bool ok = for_each_chunk([&](const pair<int, int> *edges, size_t count) {
+      for (size_t e = 0; e < count; e++) {
+        size_t needed = max(edges[e].first, edges[e].second) + 1;
+        if (needed > out_cursor.size()) {
+          out_cursor.resize(needed, 0);
+          in_cursor.resize(needed, 0);
+        }
+        out_cursor[edges[e].first]++;
+        in_cursor[edges[e].second]++;
+      }
+      num_edges += count;
+    });
+    if (!ok) return false;
+
+    int64_t V = out_cursor.size();
+    size_t size = kHeaderSize + 2 * (V + 1) * sizeof(int64_t) + 2 * num_edges * sizeof(int);
+    int fd = open(csr_file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, size) != 0) {
+      close(fd);
+      return false;
+    }
+    void *mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    char *base = static_cast<char *>(mapped);
+    int64_t header[2] = {V, num_edges};
+    memcpy(base, kMagic, sizeof(kMagic));
+    memcpy(base + sizeof(kMagic), header, sizeof(header));
+    int64_t *offsets = reinterpret_cast<int64_t *>(base + kHeaderSize);
+    int64_t *roffsets = offsets + V + 1;
+    int *neighbors = reinterpret_cast<int *>(roffsets + V + 1);
+    int *rneighbors = neighbors + num_edges;
+
+    // Degrees become offsets, and the cursors where the next edge goes
+    offsets[0] = roffsets[0] = 0;
+    for (int64_t v = 0; v < V; v++) {
+      offsets[v + 1] = offsets[v] + out_cursor[v];
+      roffsets[v + 1] = roffsets[v] + in_cursor[v];
+      out_cursor[v] = offsets[v];
+      in_cursor[v] = roffsets[v];
+    }
+    ok = for_each_chunk([&](const pair<int, int> *edges, size_t count) {
+      for (size_t e = 0; e < count; e++) {
+        neighbors[out_cursor[edges[e].first]++] = edges[e].second;
+        rneighbors[in_cursor[edges[e].second]++] = edges[e].first;
+      }
+    });
+    ok = msync(mapped, size, MS_SYNC) == 0 && ok;
+    munmap(mapped, size);
+    return ok;
+  }
+
+  // Level-synchronous BFS over the disk lists (in-lists when reverse).
+  // Light levels read only the frontier's lists, sorted by vertex so the
+  // reads move forward through the file; heavy levels sweep every
+  // unvisited vertex's opposite lists block by block, bottom-up, with the
+  // next block prefetched. Returns the height and a vertex at that depth.
+  pair<int,int> StreamBFS(const DiskGraph &g, bool reverse, int source,
+                          pvector<int> &dist, SlidingQueue<int> &queue) {
+    int64_t V = g.num_vertices();
+    dist.fill(-1);
+    dist[source] = 0;
+    queue.reset();
+    queue.push_back(source);
+    queue.slide_window();
+
+    int level = 0;
+    int64_t frontier = 1, old_frontier = 0;
+    int64_t scout_count = g.degree(source, reverse), edges_to_check = g.num_edges();
+    bool bottom_up = false, in_queue = true;
+    while (frontier > 0) {
+      if (!bottom_up) {
+        bottom_up = scout_count > edges_to_check / kAlpha;
+      } else {
+        bottom_up = frontier >= old_frontier || frontier > V / kBeta;
+      }
+      edges_to_check -= scout_count;
+      int64_t next = 0, next_scout = 0;
+
+      if (bottom_up) {
+        for (int64_t first = 0; first < V; first += kStreamBlock) {
+          int64_t last = min(V, first + kStreamBlock);
+          g.Prefetch(last, min(V, last + kStreamBlock), !reverse);
+          #pragma omp parallel for schedule(dynamic, 1024) reduction(+ : next, next_scout)
+          for (int64_t u = first; u < last; u++) {
+            if (dist[u] >= 0) continue;
+            for (const int *v = g.begin(u, !reverse); v != g.end(u, !reverse); v++) {
+              if (dist[*v] == level) {
+                dist[u] = level + 1;
+                next++;
+                next_scout += g.degree(u, reverse);
+                break;
+              }
+            }
+          }
+        }
+        in_queue = false;
+      } else {
+        if (!in_queue) {
+          // Back from bottom-up: collect the frontier from the distances
+          queue.reset();
+          #pragma omp parallel
+          {
+            QueueBuffer<int> lqueue(queue);
+            #pragma omp for
+            for (int64_t v = 0; v < V; v++)
+              if (dist[v] == level) lqueue.push_back(v);
+            lqueue.flush();
+          }
+          queue.slide_window();
+        }
+        sort(queue.begin(), queue.end());
+        #pragma omp parallel
+        {
+          QueueBuffer<int> lqueue(queue);
+          #pragma omp for schedule(dynamic, 64) reduction(+ : next, next_scout)
+          for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+            for (const int *w = g.begin(*q_iter, reverse); w != g.end(*q_iter, reverse); w++) {
+              int curr_val = dist[*w];
+              if (curr_val < 0 && compare_and_swap(dist[*w], curr_val, level + 1)) {
+                lqueue.push_back(*w);
+                next++;
+                next_scout += g.degree(*w, reverse);
+              }
+            }
+          }
+          lqueue.flush();
+        }
+        queue.slide_window();
+        in_queue = true;
+      }
+      old_frontier = frontier;
+      frontier = next;
+      scout_count = next_scout;
+      level++;
+    }
+
+    int height = level - 1, farthest = source;
+    #pragma omp parallel for reduction(max : farthest)
+    for (int64_t v = 0; v < V; v++) {
+      if (dist[v] == height) farthest = max<int>(farthest, v);
+    }
+    return make_pair(height, farthest);
+  }
+
+  // Kahn's algorithm over the condensation, starting from the sink
+  // components, so labels end up in reverse topological order like the
+  // ones Tarjan's algorithm gives the in-memory engines. scc holds one
+  // representative vertex per component on entry, dense labels on return.
+  // Each vertex's in-list is read once, in the order components finish.
+  void TopologicalRelabel(const DiskGraph &g, pvector<int> &scc) {
+    int64_t V = g.num_vertices();
+    int num_scc = 0;
+    {
+      pvector<int> dense(V, -1);
+      for (int64_t v = 0; v < V; v++) {
+        if (scc[v] == v) dense[v] = num_scc++;
+      }
+      #pragma omp parallel for
+      for (int64_t v = 0; v < V; v++) scc[v] = dense[scc[v]];
+    }
+
+    // Members of every component, grouped by a counting sort
+    pvector<int64_t> start(num_scc + 1, 0);
+    pvector<int> members(V);
+    for (int64_t v = 0; v < V; v++) start[scc[v] + 1]++;
+    for (int c = 0; c < num_scc; c++) start[c + 1] += start[c];
+    {
+      pvector<int64_t> cursor(start.begin(), start.end() - 1);
+      for (int64_t v = 0; v < V; v++) members[cursor[scc[v]]++] = v;
+    }
+
+    // Edges leaving each component
+    pvector<int64_t> pending(num_scc, 0);
+    for (int64_t first = 0; first < V; first += kStreamBlock) {
+      int64_t last = min(V, first + kStreamBlock);
+      g.Prefetch(last, min(V, last + kStreamBlock), false);
+      #pragma omp parallel for schedule(dynamic, 1024)
+      for (int64_t v = first; v < last; v++) {
+        int64_t leaving = 0;
+        for (const int *w = g.begin(v, false); w != g.end(v, false); w++) {
+          if (scc[*w] != scc[v]) leaving++;
+        }
+        if (leaving > 0) fetch_and_add(pending[scc[v]], leaving);
+      }
+    }
+
+    pvector<int> ready(num_scc);
+    pvector<int> topo(num_scc);
+    int head = 0, tail = 0, label = 0;
+    for (int c = 0; c < num_scc; c++) {
+      if (pending[c] == 0) ready[tail++] = c;
+    }
+    while (head < tail) {
+      int c = ready[head++];
+      topo[c] = label++;
+      for (int64_t i = start[c]; i < start[c + 1]; i++) {
+        int v = members[i];
+        for (const int *u = g.begin(v, true); u != g.end(v, true); u++) {
+          int d = scc[*u];
+          if (d != c && --pending[d] == 0) ready[tail++] = d;
+        }
+      }
+    }
+
+    #pragma omp parallel for
+    for (int64_t v = 0; v < V; v++) scc[v] = topo[scc[v]];
+  }
+
+  // Unassigned neighbors of v in its own part, along out-lists (in-lists
+  // when reverse)
+  int LiveDegree(const DiskGraph &g, bool reverse, int v, const pvector<int> &part,
+                 const pvector<int> &scc) {
+    int live = 0;
+    for (const int *w = g.begin(v, reverse); w != g.end(v, reverse); w++) {
+      if (scc[*w] < 0 && part[*w] == part[v]) live++;
+    }
+    return live;
+  }
+
+  // Assigns, until none is left, every unassigned vertex without an in- or
+  // out-neighbor among the unassigned vertices of its part: it lies on no
+  // cycle, so it is an SCC of its own. A DAG goes entirely, in one sweep
+  // to count neighbors plus one read of each peeled vertex's lists.
+  void Trim(const DiskGraph &g, const pvector<int> &part, pvector<int> &scc,
+            pvector<int> &live_in, pvector<int> &live_out, SlidingQueue<int> &queue) {
+    int64_t V = g.num_vertices();
+    queue.reset();
+    for (int64_t first = 0; first < V; first += kStreamBlock) {
+      int64_t last = min(V, first + kStreamBlock);
+      g.Prefetch(last, min(V, last + kStreamBlock), false);
+      g.Prefetch(last, min(V, last + kStreamBlock), true);
+      #pragma omp parallel
+      {
+        QueueBuffer<int> lqueue(queue);
+        #pragma omp for schedule(dynamic, 1024)
+        for (int64_t v = first; v < last; v++) {
+          if (scc[v] >= 0) continue;
+          live_in[v] = LiveDegree(g, true, v, part, scc);
+          live_out[v] = LiveDegree(g, false, v, part, scc);
+          if (live_in[v] == 0 || live_out[v] == 0) lqueue.push_back(v);
+        }
+        lqueue.flush();
+      }
+    }
+    queue.slide_window();
+
+    // Peeling a vertex takes it off its neighbors' counts; whichever
+    // count of a neighbor reaches zero first peels it
+    while (!queue.empty()) {
+      for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) scc[*q_iter] = *q_iter;
+      sort(queue.begin(), queue.end());
+      #pragma omp parallel
+      {
+        QueueBuffer<int> lqueue(queue);
+        #pragma omp for schedule(dynamic, 64)
+        for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+          int v = *q_iter;
+          for (int reverse = 0; reverse < 2; reverse++) {
+            pvector<int> &live = reverse ? live_out : live_in;
+            for (const int *w = g.begin(v, reverse); w != g.end(v, reverse); w++) {
+              // -2 holds a vertex both of whose counts reach zero to one push
+              if (scc[*w] == -1 && part[*w] == part[v] && fetch_and_add(live[*w], -1) == 1 &&
+                  compare_and_swap(scc[*w], -1, -2)) {
+                lqueue.push_back(*w);
+              }
+            }
+          }
+        }
+        lqueue.flush();
+      }
+      queue.slide_window();
+    }
+  }
+
+  // Marks with stamp every vertex the frontier in queue reaches along
+  // out-lists (in-lists when reverse) without leaving the unassigned
+  // vertices of its part. Sources must be marked already.
+  void Reach(const DiskGraph &g, bool reverse, const pvector<int> &part,
+             const pvector<int> &scc, pvector<int> &mark, int stamp, SlidingQueue<int> &queue) {
+    while (!queue.empty()) {
+      sort(queue.begin(), queue.end());
+      #pragma omp parallel
+      {
+        QueueBuffer<int> lqueue(queue);
+        #pragma omp for schedule(dynamic, 64)
+        for (auto q_iter = queue.begin(); q_iter < queue.end(); q_iter++) {
+          int v = *q_iter;
+          for (const int *w = g.begin(v, reverse); w != g.end(v, reverse); w++) {
+            int curr_val = mark[*w];
+            if (curr_val != stamp && scc[*w] < 0 && part[*w] == part[v] &&
+                compare_and_swap(mark[*w], curr_val, stamp)) {
+              lqueue.push_back(*w);
+            }
+          }
+        }
+        lqueue.flush();
+      }
+      queue.slide_window();
+    }
+  }
+
+  uint64_t Mix(uint64_t z) {
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  // Forward-backward decomposition with trimming, needing only vertex
+  // arrays and reads of whole lists. Unassigned vertices are split into
+  // parts no SCC crosses, at first one. Every round trims, then picks a
+  // random pivot in each part and reaches forward and backward from all of
+  // them at once: the vertices reached both ways are the pivot's SCC, and
+  // the ones reached one way, the other way or neither become three new
+  // parts. A round reads each list at most three times, and random pivots
+  // leave O(log V) rounds expected. A part is labeled by one of its
+  // vertices, and so is every SCC.
+  void DecomposeSCC(const DiskGraph &g, pvector<int> &scc) {
+    int64_t V = g.num_vertices();
+    const int kNone = numeric_limits<int>::max();
+    pvector<int> part(V, 0), forward(V, -1), backward(V, -1), live_in(V), live_out(V);
+    pvector<uint64_t> pivot(V);
+    pvector<int> split[3] = {pvector<int>(V), pvector<int>(V), pvector<int>(V)};
+    SlidingQueue<int> queue(V);
+    scc.fill(-1);
+
+    for (int round = 0; ; round++) {
+      Trim(g, part, scc, live_in, live_out, queue);
+
+      // Each part's pivot is the member of largest hash, which sits in the
+      // high half of the key; the low half names the vertex
+      pivot.fill(0);
+      int64_t remaining = 0;
+      #pragma omp parallel for reduction(+ : remaining)
+      for (int64_t v = 0; v < V; v++) {
+        if (scc[v] >= 0) continue;
+        remaining++;
+        uint64_t key = (Mix(v ^ ((uint64_t)round << 32)) << 32) | (uint64_t)v;
+        for (uint64_t curr_val = pivot[part[v]]; curr_val < key; curr_val = pivot[part[v]]) {
+          if (compare_and_swap(pivot[part[v]], curr_val, key)) break;
+        }
+      }
+      if (remaining == 0) break;
+
+      for (int reverse = 0; reverse < 2; reverse++) {
+        pvector<int> &mark = reverse ? backward : forward;
+        queue.reset();
+        #pragma omp parallel
+        {
+          QueueBuffer<int> lqueue(queue);
+          #pragma omp for
+          for (int64_t v = 0; v < V; v++) {
+            if (scc[v] < 0 && (int)(pivot[part[v]] & 0xFFFFFFFF) == v) {
+              mark[v] = round;
+              lqueue.push_back(v);
+            }
+          }
+          lqueue.flush();
+        }
+        queue.slide_window();
+        Reach(g, reverse, part, scc, mark, round, queue);
+      }
+
+      // Split every part three ways, naming each new one by its smallest
+      // vertex; the SCC found takes its pivot's name
+      for (int k = 0; k < 3; k++) split[k].fill(kNone);
+      #pragma omp parallel for
+      for (int64_t v = 0; v < V; v++) {
+        if (scc[v] >= 0) continue;
+        bool reached = forward[v] == round, reaching = backward[v] == round;
+        if (reached && reaching) continue;
+        int &name = split[reached ? 1 : reaching ? 2 : 0][part[v]];
+        for (int curr_val = name; v < curr_val; curr_val = name) {
+          if (compare_and_swap(name, curr_val, (int)v)) break;
+        }
+      }
+      #pragma omp parallel for
+      for (int64_t v = 0; v < V; v++) {
+        if (scc[v] >= 0) continue;
+        bool reached = forward[v] == round, reaching = backward[v] == round;
+        if (reached && reaching) {
+          scc[v] = pivot[part[v]] & 0xFFFFFFFF;
+        } else {
+          part[v] = split[reached ? 1 : reaching ? 2 : 0][part[v]];
+        }
+      }
+    }
+    TopologicalRelabel(g, scc);
+  }
+
+  // xorshift state, owned by each run so concurrent runs don't share it
+  struct RandomState {
+      unsigned long long x = 123456789;
+      unsigned long long y = 362436039;
+      unsigned long long z = 521288629;
+      unsigned long long w = 88675123;
+  };
+
+  int GetRandom(RandomState &s, int V) {
+      unsigned long long t;
+
+      t = s.x ^ (s.x << 11);
+      s.x = s.y;
+      s.y = s.z;
+      s.z = s.w;
+      s.w = (s.w ^ (s.w >> 19)) ^ (t ^ (t >> 8));
+
+      return  s.w % V;
+  }
+} // end namespace
+
+namespace Diameter {
+  bool BuildDiskCSR(const char *edges_file, const char *csr_file) {
+    return WriteDiskCSR(csr_file, [&](const EdgeVisitor &visit) {
+      return ForEachEdgeChunk(edges_file, visit);
+    });
+  }
+
+  bool BuildDiskCSR(const vector <pair<int, int> > &edges, const char *csr_file) {
+    for (const pair<int, int> &edge : edges) {
+      if (edge.first < 0 || edge.second < 0) return false;
+    }
+    return WriteDiskCSR(csr_file, [&](const EdgeVisitor &visit) {
+      visit(edges.data(), edges.size());
+      return true;
+    });
+  }
+
+  // The @kawatea bounding algorithm with every graph access going to disk
+  int GetSemiExternalDiam(const char *csr_file) {
+    DiskGraph g;
+    if (!g.Open(csr_file)) return -1;
+    int num_double_sweep = 10, diameter = 0, V = g.num_vertices();
+    if (V == 0) return 0;
+
+    // Decompose the graph into strongly connected components
+    pvector<int> scc(V);
+    DecomposeSCC(g, scc);
+
+    // Compute the diameter lower bound by the double sweep algorithm
+    pvector<int> distance(V);
+    SlidingQueue<int> frontier(V);
+    RandomState random;
+    for (int i = 0; i < num_double_sweep; i++) {
+      pair<int,int> dist_node = StreamBFS(g, false, GetRandom(random, V), distance, frontier);
+      diameter = max(diameter, dist_node.first);
+      diameter = max(diameter, StreamBFS(g, true, dist_node.second, distance, frontier).first);
+    }
+
+    // Order vertices, one sequential sweep over both directions
+    pvector <pair<long long, int> > order(V);
+    for (int64_t first = 0; first < V; first += kStreamBlock) {
+      int64_t last = min<int64_t>(V, first + kStreamBlock);
+      g.Prefetch(last, min<int64_t>(V, last + kStreamBlock), false);
+      g.Prefetch(last, min<int64_t>(V, last + kStreamBlock), true);
+      #pragma omp parallel for schedule(dynamic, 1024)
+      for (int64_t v = first; v < last; v++) {
+        long long in = 0, out = 0;
+        for (const int *u = g.begin(v, true); u != g.end(v, true); u++) {
+          if (scc[*u] == scc[v]) in++;
+        }
+        for (const int *w = g.begin(v, false); w != g.end(v, false); w++) {
+          if (scc[*w] == scc[v]) out++;
+        }
+        order[v] = make_pair(-(in * out), (int)v);
+      }
+    }
+    // By SCC, then by decreasing product, which can take all 64 bits
+    sort(order.begin(), order.end(), [&](const pair<long long, int> &a, const pair<long long, int> &b) {
+      return scc[a.second] != scc[b.second] ? scc[a.second] < scc[b.second] : a < b;
+    });
+
+    // Examine every vertex
+    int qs, qt;
+    pvector <int> dist(V, -1);
+    pvector <int> queue(V);
+    pvector <int> ecc(V, V);
+    for (int i = 0; i < V; i++) {
+      int u = order[i].second;
+
+      if (ecc[u] <= diameter) continue;
+
+      // Refine the eccentricity upper bound
+      int ub = 0;
+      vector <pair<int, int> > neighbors;
+      for (const int *w = g.begin(u, false); w != g.end(u, false); w++) {
+        neighbors.push_back(make_pair(scc[*w], ecc[*w] + 1));
+      }
+      sort(neighbors.begin(), neighbors.end());
+
+      for (size_t j = 0; j < neighbors.size(); ) {
+        int component = neighbors[j].first;
+        int lb = V;
+
+        for (; j < neighbors.size(); j++) {
+          if (neighbors[j].first != component) break;
+          lb = min(lb, neighbors[j].second);
+        }
+
+        ub = max(ub, lb);
+
+        if (ub > diameter) break;
+      }
+
+      if (ub <= diameter) {
+        ecc[u] = ub;
+        continue;
+      }
+
+      // Conduct a BFS and update bounds
+      ecc[u] = StreamBFS(g, false, u, distance, frontier).first;
+      diameter = max(diameter, ecc[u]);
+
+      qs = qt = 0;
+      dist[u] = 0;
+      queue[qt++] = u;
+
+      while (qs < qt) {
+        int v = queue[qs++];
+
+        ecc[v] = min(ecc[v], dist[v] + ecc[u]);
+
+        for (const int *w = g.begin(v, true); w != g.end(v, true); w++) {
+          // only inside an SCC
+          if (dist[*w] < 0 && scc[*w] == scc[u]) {
+            dist[*w] = dist[v] + 1;
+            queue[qt++] = *w;
+          }
+        }
+      }
+
+      for (int j = 0; j < qt; j++) dist[queue[j]] = -1;
+    }
+    return diameter;
+  }
+} // end namespace Diameter
@@ -0,0 +1,24 @@
+# ifndef SEMIEXT_H
+# define SEMIEXT_H
+
+#include <vector>
+
+using namespace std;
+
+namespace Diameter {
+  // Writes an edge file (text pairs, or the binary format if it ends in
+  // .bin) as a disk-resident CSR holding both the forward and the reverse
+  // adjacency. Edges are streamed twice, so only per-vertex arrays are ever
+  // held in memory. Fails on a negative vertex ID.
+  bool BuildDiskCSR(const char *edges_file, const char *csr_file);
+
+  // Same, from edges already in memory
+  bool BuildDiskCSR(const vector <pair<int, int> > &edges, const char *csr_file);
+
+  // Semi-external diameter of a disk CSR: the graph stays mmapped and is
+  // streamed sequentially a level at a time, while only per-vertex arrays
+  // (distances, eccentricity bounds, SCC labels, frontier) live in memory.
+  // Returns -1 if the file can't be opened.
+  int GetSemiExternalDiam(const char *csr_file);
+} // end namespace Diameter
+# endif
@@ -0,0 +1,100 @@
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "server.h"
+
+using namespace std;
+
+namespace {
+  bool ParseVertex(istringstream &in, const Generator::IdMap &ids, int V, int &v) {
+    long long id;
+    return (bool)(in >> id) && ids.ToDense(id, V, v);
+  }
+} // end namespace
+
+namespace Diameter {
+  string AnswerQuery(DiameterSolver &solver, const Generator::IdMap &ids,
+                     const string &query) {
+    istringstream in(query);
+    string command;
+    in >> command;
+    int V = solver.NumVertices();
+    ostringstream reply;
+
+    if (command == "ecc") {
+      int v, count = 0;
+      for (; ParseVertex(in, ids, V, v); count++) {
+        reply << (count > 0 ? " " : "") << solver.GetEccentricity(v);
+      }
+      if (count == 0 || !in.eof()) return "error ecc needs vertices of the graph";
+    } else if (command == "diameter") {
+      reply << solver.GetDiameter();
+    } else if (command == "radius") {
+      reply << solver.GetRadius();
+    } else if (command == "scc") {
+      int v;
+      if (!ParseVertex(in, ids, V, v)) return "error scc needs a vertex of the graph";
+      const pvector<int> &scc = solver.GetSCC();
+      int size = 0;
+      #pragma omp parallel for reduction(+ : size)
+      for (int w = 0; w < V; w++) size += scc[w] == scc[v];
+      reply << scc[v] << " " << size << " " << solver.GetComponentDiameter(scc[v]);
+    } else {
+      return "error unknown query " + command;
+    }
+    return reply.str();
+  }
+
+  void ServeStream(DiameterSolver &solver, const Generator::IdMap &ids, FILE *in, FILE *out) {
+    char *line = NULL;
+    size_t capacity = 0;
+    for (ssize_t length; (length = getline(&line, &capacity, in)) >= 0; ) {
+      string query(line, length);
+      query.erase(query.find_last_not_of(" \t\r\n") + 1);
+      if (query.empty()) continue;
+      if (query == "quit") break;
+      fprintf(out, "%s\n", AnswerQuery(solver, ids, query).c_str());
+      fflush(out);
+    }
+    free(line);
+  }
+
+  bool ServeSocket(DiameterSolver &solver, const Generator::IdMap &ids, const string &path) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    strcpy(address.sun_path, path.c_str());
+
+    // A client hanging up mid-reply must not take the server down
+    signal(SIGPIPE, SIG_IGN);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) return false;
+    unlink(path.c_str());
+    if (bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+      close(listener);
+      return false;
+    }
+
+    for (int client; (client = accept(listener, NULL, NULL)) >= 0; ) {
+      thread([&solver, &ids, client]() {
+        FILE *in = fdopen(client, "r");
+        FILE *out = fdopen(dup(client), "w");
+        if (in != NULL && out != NULL) ServeStream(solver, ids, in, out);
+        if (in != NULL) fclose(in);
+        else close(client);
+        if (out != NULL) fclose(out);
+      }).detach();
+    }
+    close(listener);
+    return true;
+  }
+} // end namespace Diameter
@@ -0,0 +1,29 @@
+# ifndef SERVER_H
+# define SERVER_H
+
+#include <stdio.h>
+#include <string>
+#include "diamrallel.h"
+#include "graphgen.h"
+
+using namespace std;
+
+namespace Diameter {
+  // Answers one line of the query protocol:
+  //   ecc v [v ...]   eccentricity of each vertex, space separated
+  //   diameter        diameter of the graph
+  //   radius          radius of the graph
+  //   scc v           label, size and diameter of the SCC of v
+  // Vertices are given by their IDs in the input, translated by ids. The
+  // reply has no trailing newline; bad queries get "error <reason>".
+  string AnswerQuery(DiameterSolver &solver, const Generator::IdMap &ids,
+                     const string &query);
+
+  // Answers queries from in on out, a line each, until EOF or "quit"
+  void ServeStream(DiameterSolver &solver, const Generator::IdMap &ids, FILE *in, FILE *out);
+
+  // Serves the same protocol on a Unix domain socket at path, a thread per
+  // client, until the process is killed. False if the socket can't be set up.
+  bool ServeSocket(DiameterSolver &solver, const Generator::IdMap &ids, const string &path);
+} // end namespace Diameter
+# endif
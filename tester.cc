@@ -1,13 +1,19 @@
 #include <algorithm>
 #include <cstdlib>
-#include <fstream>
 #include <functional>
 #include <iostream>
 #include <stdlib.h>
 #include <sys/time.h>
 #include <vector>
+#include <omp.h>
+#include "autoselect.h"
+#include "batch.h"
 #include "diameter.h"
 #include "diamrallel.h"
+#include "graphgen.h"
+#include "reduce.h"
+#include "semiext.h"
+#include "server.h"
 
 using namespace std;
 
@@ -15,60 +21,9 @@ namespace {
   // Work around for lack of pvector constructor disallowing function ptr call
   enum FuncEnum {SLOW_PARA, PAPER_PARA};
 
-  void GenStar(int starsize) {
-    ofstream starFile;
-    starFile.open("graphs/star.edges");
-    for (int i = 0; i < starsize; i++) {
-      for (int j = 0; j < starsize; j++) {
-        if (i != j) {
-          starFile << i << " " << j << "\n";
-        }
-      }
-    }
-    for (int i = starsize; i < 2*starsize; i++) {
-      for (int j = 0; j < starsize; j++) {
-        // connect every "angle" node to every edge in the maximal subgraph
-        starFile << i << " " << j << "\n";
-      }
-    }
-  }
-
-  void GenPath(int pathlen) {
-    ofstream pathFile;
-    pathFile.open("graphs/path.edges");
-    for (int i = 0; i < pathlen; i++) {
-      pathFile << i << " " << i + 1 << "\n";
-    }
-    pathFile.close();
-  }
-
-  void GenMaximal(int size) {
-    ofstream maximalFile;
-    maximalFile.open("graphs/maximal.edges");
-    for (int i = 0; i < size; i++) {
-      for (int j = 0; j < size; j++) {
-        if (i != j) {
-          maximalFile << i << " " << j << "\n";
-        }
-      }
-    }
-    maximalFile.close();
-  }
-
-  // Note that if a vertex has no neighbors we must include an empty vector
-  // since we use index in outer vector to determine vertex number.
-  vector <vector<int> > GenGraph(const vector <pair<int, int> > &edges) {
-    int max_node = 0;
-    vector <vector<int> > adjlist;
-    for (pair<int, int> edge : edges) {
-      max_node = max({max_node, edge.first + 1, edge.second + 1});
-    }
-    adjlist.resize(max_node);
-
-    for (pair<int, int> edge : edges) {
-      adjlist[edge.first].push_back(edge.second);
-    }
-    return adjlist;
+  bool HasSuffix(const string &str, const string &suffix) {
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
   }
 
   double GetTime() {
@@ -94,7 +49,10 @@ namespace {
     return make_pair(diam, total_time/trials);
   }
 
-  pair<int, double> RunTrials(const pvector <pvector<int> > &padjlist, FuncEnum func, const int trials) {
+  pair<int, double> RunTrials(const pvector <pvector<int> > &padjlist, FuncEnum func, const int trials,
+                              bool tune_direction, const string &checkpoint_file,
+                              double checkpoint_interval, const Diameter::SweepOptions &sweeps,
+                              int64_t segment_width, const vector<int> &depth) {
     double total_time = 0;
     int diam = 0;
 
@@ -102,10 +60,11 @@ namespace {
     for (int i = 0; i < trials; i++) {
       switch (func) {
         case SLOW_PARA:
-          diam = Diameter::GetBruteDiamParallel(padjlist);
+          diam = Diameter::GetBruteDiamParallel(padjlist, tune_direction, depth);
           break;
         case PAPER_PARA:
-          diam = Diameter::GetFastDiamParallel(padjlist);
+          diam = Diameter::GetFastDiamParallel(padjlist, tune_direction, checkpoint_file,
+                                               checkpoint_interval, sweeps, segment_width, depth);
           break;
         default:
           return make_pair(-1,-1);
@@ -121,7 +80,23 @@ namespace {
 int main(int argc, char** argv) {
   int trials = 10; // attempt to normalize runs
   char *filename = (char *)"graphs/simple.edges";
+  char *out_filename = NULL, *csr_filename = NULL, *semiext_filename = NULL;
+  char *manifest_filename = NULL, *socket_path = NULL, *auto_log = NULL;
+  string checkpoint_file;
+  double checkpoint_interval = 600;
+  long long delta = 0;
+  int lanes = 0;
+  int64_t segment_width = Diameter::kDefaultSegmentWidth;
+  Diameter::SweepOptions sweeps = Diameter::kDefaultSweeps;
   bool run_paper = false, run_slow = false, run_para_slow = false, run_para_paper = false;
+  bool gen_graph = false, undirected = false, tune_direction = true, run_radius = false;
+  bool serve_stdin = false, run_auto = false, compact = false, weighted = false;
+  bool sweep_start_given = false;
+  bool peel = false, twins = false, scc_table = false, simplify = false;
+  vector<long long> ecc_queries;
+  Generator::GenKind gen_kind = Generator::GEN_RMAT;
+  int gen_scale = 10, gen_degree = 16;
+  unsigned long long gen_seed = 27491095;
   for (int i = 1; i < argc; ++i) {
       if (string(argv[i]) == "--trials") {
           if (i + 1 < argc) {
@@ -137,14 +112,269 @@ int main(int argc, char** argv) {
               cerr << "--graph option requires one argument." << endl;
             return 1;
         }
-      } else if (string(argv[i]) == "--paper") run_paper = true;
+      } else if (string(argv[i]) == "--gen") {
+        if (i + 1 < argc && Generator::ParseKind(argv[i + 1], gen_kind)) {
+            gen_graph = true;
+            filename = argv[++i];
+        } else { // Generator flag called but unspecified or unknown
+              cerr << "--gen option requires one of rmat, er, grid, path, star, maximal." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--scale" || string(argv[i]) == "--degree" ||
+                 string(argv[i]) == "--seed") {
+        if (i + 1 < argc) {
+            string flag = argv[i];
+            if (flag == "--scale") gen_scale = atoi(argv[++i]);
+            else if (flag == "--degree") gen_degree = atoi(argv[++i]);
+            else gen_seed = strtoull(argv[++i], NULL, 10);
+        } else { // Generator parameter called but unspecified
+              cerr << argv[i] << " option requires one argument." << endl;
+            return 1;
+        }
+        if (gen_scale < 0 || gen_scale > Generator::kMaxScale) {
+              cerr << "--scale option requires a value from 0 to " << Generator::kMaxScale << "."
+                   << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--write_graph") {
+        if (i + 1 < argc) {
+            out_filename = argv[++i];
+        } else { // Output flag called but unspecified
+              cerr << "--write_graph option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--build_csr" || string(argv[i]) == "--semiext") {
+        if (i + 1 < argc) {
+            if (string(argv[i]) == "--build_csr") csr_filename = argv[++i];
+            else semiext_filename = argv[++i];
+        } else {
+              cerr << argv[i] << " option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--batch") {
+        if (i + 1 < argc) {
+            manifest_filename = argv[++i];
+        } else {
+              cerr << "--batch option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--socket") {
+        if (i + 1 < argc) {
+            socket_path = argv[++i];
+        } else {
+              cerr << "--socket option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--sweeps") {
+        if (i + 1 < argc) {
+            sweeps.count = atoi(argv[++i]);
+        } else {
+              cerr << "--sweeps option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--sweep_start") {
+        if (i + 1 < argc && Diameter::ParseSweepStart(argv[i + 1], sweeps.start)) {
+            sweep_start_given = true;
+            i++;
+        } else {
+              cerr << "--sweep_start option requires one of random, degree, four, scc." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--auto_log") {
+        if (i + 1 < argc) {
+            auto_log = argv[++i];
+        } else {
+              cerr << "--auto_log option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--checkpoint") {
+        if (i + 1 < argc) {
+            checkpoint_file = argv[++i];
+        } else { // Checkpoint flag called but unspecified
+              cerr << "--checkpoint option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--checkpoint_every") {
+        if (i + 1 < argc) {
+            checkpoint_interval = atof(argv[++i]);
+        } else { // Checkpoint interval called but unspecified
+              cerr << "--checkpoint_every option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--segment_width") {
+        if (i + 1 < argc) {
+            segment_width = strtoll(argv[++i], NULL, 10);
+        } else { // Segment width called but unspecified
+              cerr << "--segment_width option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--interleave") {
+        if (i + 1 < argc) {
+            lanes = atoi(argv[++i]);
+        } else { // Lane count called but unspecified
+              cerr << "--interleave option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--delta") {
+        if (i + 1 < argc) {
+            delta = strtoll(argv[++i], NULL, 10);
+        } else { // Bucket width called but unspecified
+              cerr << "--delta option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--ecc") {
+        if (i + 1 < argc) {
+            ecc_queries.push_back(strtoll(argv[++i], NULL, 10));
+        } else { // Eccentricity flag called but unspecified
+              cerr << "--ecc option requires one argument." << endl;
+            return 1;
+        }
+      } else if (string(argv[i]) == "--undirected") undirected = true;
+      else if (string(argv[i]) == "--radius") run_radius = true;
+      else if (string(argv[i]) == "--serve") serve_stdin = true;
+      else if (string(argv[i]) == "--auto") run_auto = true;
+      else if (string(argv[i]) == "--compact") compact = true;
+      else if (string(argv[i]) == "--weighted") weighted = true;
+      else if (string(argv[i]) == "--peel") peel = true;
+      else if (string(argv[i]) == "--twins") twins = true;
+      else if (string(argv[i]) == "--scc_table") scc_table = true;
+      else if (string(argv[i]) == "--simplify") simplify = true;
+      else if (string(argv[i]) == "--no_tune") tune_direction = false;
+      else if (string(argv[i]) == "--paper") run_paper = true;
       else if (string(argv[i]) == "--slow") run_slow = true;
       else if (string(argv[i]) == "--para_slow") run_para_slow = true;
       else if (string(argv[i]) == "--para_paper") run_para_paper = true;
   }
 
+  if (manifest_filename != NULL) {
+    vector<string> filenames;
+    if (!Diameter::ReadManifest(manifest_filename, filenames)) {
+        fprintf(stderr, "Can't open manifest file\n");
+        return -1;
+    }
+    // One line per graph, in completion order
+    double start = GetTime();
+    Diameter::RunBatch(filenames, undirected, compact, simplify,
+                       [](const Diameter::BatchResult &result) {
+      printf("%s\t%d\t%d\t%lld\t%f\n", result.filename.c_str(), result.diameter,
+             result.num_vertices, (long long)result.num_edges, result.seconds);
+      fflush(stdout);
+    });
+    fprintf(stderr, "Batch of %zu graphs completed in %f seconds\n", filenames.size(),
+            GetTime() - start);
+    return 0;
+  }
+
+  if (weighted) {
+    if (peel || twins || run_auto || !checkpoint_file.empty()) {
+        fprintf(stderr, "--peel, --twins, --auto and --checkpoint don't apply to --weighted\n");
+        return -1;
+    }
+    // Generated graphs get random weights, symmetrized after so both
+    // directions of an undirected edge weigh the same
+    vector<Generator::WeightedEdge> edges;
+    vector <pair<int64_t, int64_t> > raw_edges;
+    vector<int> raw_weights;
+    if (gen_graph) {
+      edges = Generator::AddRandomWeights(
+          Generator::Generate(gen_kind, gen_scale, gen_degree, gen_seed), 255, gen_seed);
+    } else if (compact) {
+      if (!Generator::ReadWeightedEdges64(filename, raw_edges, raw_weights)) {
+          fprintf(stderr, "Can't read weighted edges file\n");
+          return -1;
+      }
+    } else if (!Generator::ReadWeightedEdges(filename, edges)) {
+        fprintf(stderr, "Can't read weighted edges file\n");
+        return -1;
+    }
+    if (compact) {
+      // Generated IDs go through the same relabeling as read ones
+      double start = GetTime();
+      for (const Generator::WeightedEdge &edge : edges) {
+        raw_edges.push_back(make_pair((int64_t)edge.from, (int64_t)edge.to));
+        raw_weights.push_back(edge.weight);
+      }
+      Generator::IdMap ids;
+      if (!Generator::CompactIDs(raw_edges, raw_weights, edges, ids)) {
+          fprintf(stderr, "Too many distinct vertex IDs\n");
+          return -1;
+      }
+      if (!ids.original.empty()) {
+        printf("Compacted IDs to %zu vertices (largest ID %lld) in %f seconds\n",
+               ids.original.size(), (long long)ids.original.back(), GetTime() - start);
+      }
+    }
+    if (undirected) Generator::Symmetrize(edges);
+
+    pvector <pvector<int> > adjlist, weights;
+    int64_t dropped = 0;
+    Diameter::BuildWeightedGraph(edges, adjlist, weights, simplify, &dropped);
+    if (simplify) {
+      printf("Dropped %lld duplicate edges and self loops of %zu\n", (long long)dropped,
+             edges.size());
+    }
+    double start = GetTime();
+    long long diameter = Diameter::GetFastDiamWeighted(adjlist, weights, delta, sweeps);
+    printf("The weighted, delta-stepping solution says the diameter of the graph is: %lld\n",
+           diameter);
+    printf("This weighted operation was completed in:                     %f seconds \n\n",
+           GetTime() - start);
+    return 0;
+  }
+
+  // A disk CSR is built straight from an edge file when possible, so the
+  // edges never have to fit in memory
+  bool serve = serve_stdin || socket_path != NULL;
+  bool use_solver = run_radius || scc_table || !ecc_queries.empty() || serve;
+  bool in_memory = run_paper || run_slow || run_para_slow || run_para_paper ||
+                   run_auto || use_solver || out_filename != NULL;
+  if ((peel || twins) && use_solver) {
+      fprintf(stderr, "--peel and --twins renumber vertices and only applies to whole-graph diameters\n");
+      return -1;
+  }
+  if (peel && (csr_filename != NULL || out_filename != NULL)) {
+      fprintf(stderr, "--peel keeps whisker depths beside the graph, which --build_csr and --write_graph can't store\n");
+      return -1;
+  }
+  if (simplify && semiext_filename != NULL && csr_filename == NULL) {
+      fprintf(stderr, "--simplify can't change an existing disk CSR; build it with --build_csr\n");
+      return -1;
+  }
+  bool csr_from_edges = csr_filename != NULL && (gen_graph || undirected || compact || twins ||
+                                                 simplify);
+  if (csr_filename != NULL && !csr_from_edges) {
+    double start = GetTime();
+    if (!Diameter::BuildDiskCSR(filename, csr_filename)) {
+        fprintf(stderr, "Can't build disk CSR\n");
+        return -1;
+    }
+    printf("Built disk CSR %s in %f seconds\n", csr_filename, GetTime() - start);
+  }
+
   vector <pair<int, int> > edges;
-  {
+  vector <pair<int64_t, int64_t> > raw_edges;
+  Generator::IdMap ids;
+  if (gen_graph) {
+    double start = GetTime();
+    edges = Generator::Generate(gen_kind, gen_scale, gen_degree, gen_seed);
+    if (undirected) Generator::Symmetrize(edges);
+    printf("Generated %zu edges on 2^%d vertices in %f seconds\n", edges.size(),
+           gen_scale, GetTime() - start);
+  } else if (!in_memory && !csr_from_edges) {
+    // nothing else needs the edges
+  } else if (HasSuffix(filename, ".bin")) {
+    if (!Generator::ReadBinaryEdges(filename, edges)) {
+        fprintf(stderr, "Can't read binary edges file\n");
+        return -1;
+    }
+    if (undirected) Generator::Symmetrize(edges);
+  } else if (compact) {
+    // IDs may not even fit in an int until they are compacted below
+    if (!Generator::ReadTextEdges64(filename, raw_edges)) {
+        fprintf(stderr, "Can't open edges file\n");
+        return -1;
+    }
+  } else {
     FILE *in = fopen(filename, "r");
 
     if (in == NULL) {
@@ -156,46 +386,251 @@ int main(int argc, char** argv) {
       edges.push_back(std::make_pair(from, to));
     }
     fclose(in);
+    if (undirected) Generator::Symmetrize(edges);
+  }
+  if (compact && (!edges.empty() || !raw_edges.empty())) {
+    double start = GetTime();
+    bool ok = raw_edges.empty() ? Generator::CompactIDs(edges, ids)
+                                : Generator::CompactIDs(raw_edges, edges, ids);
+    if (!ok) {
+        fprintf(stderr, "Too many distinct vertex IDs\n");
+        return -1;
+    }
+    // relabeling keeps already symmetric edges symmetric
+    if (!raw_edges.empty() && undirected) Generator::Symmetrize(edges);
+    vector <pair<int64_t, int64_t> >().swap(raw_edges);
+    printf("Compacted IDs to %zu vertices (largest ID %lld) in %f seconds\n",
+           ids.original.size(), (long long)ids.original.back(), GetTime() - start);
+  }
+  // Twins first: the path MergeTwins keeps its distances on is then peeled
+  // like any other whisker
+  if (twins && !edges.empty()) {
+    double start = GetTime();
+    vector <pair<int, int> > reduced;
+    Diameter::TwinStats stats;
+    Diameter::MergeTwins(edges, reduced, stats);
+    edges.swap(reduced);
+    printf("Merged %d twin vertices in %d classes (twin distance %d) in %f seconds\n",
+           stats.merged, stats.classes, stats.twin_distance, GetTime() - start);
+  }
+  // The engines count whiskers through depth, and paths inside the trees of
+  // one core vertex through whisker_diameter
+  vector<int> depth;
+  int whisker_diameter = 0;
+  if (peel && !edges.empty()) {
+    double start = GetTime();
+    vector <pair<int, int> > reduced;
+    Diameter::PeelStats stats;
+    if (!Diameter::PeelWhiskers(edges, reduced, depth, stats)) {
+        fprintf(stderr, "Can't peel whiskers off a directed graph; try --undirected\n");
+        return -1;
+    }
+    edges.swap(reduced);
+    whisker_diameter = stats.tree_diameter;
+    printf("Peeled %d whisker vertices down to a core of %d (whisker diameter %d) in %f seconds\n",
+           stats.peeled, stats.core, stats.tree_diameter, GetTime() - start);
+  }
+  if (out_filename != NULL && !Generator::WriteBinaryEdges(out_filename, edges)) {
+      fprintf(stderr, "Can't write binary edges file\n");
+      return -1;
+  }
+  // The disk CSR is written from the edges themselves, so they are
+  // simplified before it rather than as lists
+  int64_t edges_in = edges.size(), dropped = -1;
+  if (csr_from_edges && simplify) dropped = Generator::SimplifyEdges(edges);
+  if (csr_from_edges) {
+    double start = GetTime();
+    if (!Diameter::BuildDiskCSR(edges, csr_filename)) {
+        fprintf(stderr, "Can't build disk CSR\n");
+        return -1;
+    }
+    printf("Built disk CSR %s in %f seconds\n", csr_filename, GetTime() - start);
+  }
+
+  // Both builds drop the same edges, so either count will do
+  bool simplify_lists = simplify && dropped < 0;
+  vector <vector<int> > adjlist;
+  if (run_paper || run_slow) {
+     adjlist = Diameter::BuildGraph(edges, simplify_lists, simplify_lists ? &dropped : NULL);
   }
-  const vector <vector<int> > adjlist = GenGraph(edges);
   pvector< pvector<int> > padjlist;
-  if (run_para_slow || run_para_paper) {
-     padjlist = Diameter::BuildTSGraph(edges);
+  if (run_para_slow || run_para_paper || run_auto || use_solver) {
+     padjlist = Diameter::BuildTSGraph(edges, simplify_lists, simplify_lists ? &dropped : NULL);
+  }
+  if (simplify && dropped >= 0) {
+    printf("Dropped %lld duplicate edges and self loops of %lld\n", (long long)dropped,
+           (long long)edges_in);
   }
 
   {
     // Return of format (diameter, average time)
-    printf("Our graph is from file:  %s\n", filename);
+    if (gen_graph) {
+      printf("Our graph is generated:  %s, scale %d, degree %d\n", filename,
+             gen_scale, gen_degree);
+    } else {
+      printf("Our graph is from file:  %s\n", filename);
+    }
 
     pair<int, double> fast_diam_time, brute_para_diam_time, brute_diam_time, paper_para_diam_time;
+    if (run_auto) {
+      // Statistics first, then whichever engine the cost model picks
+      double start = GetTime();
+      Diameter::DiameterSolver solver(padjlist);
+      solver.SetSegmentWidth(segment_width);
+      Diameter::GraphStats stats = Diameter::GatherStats(solver);
+      Diameter::EngineChoice choice = Diameter::ChooseEngine(stats, omp_get_max_threads());
+      if (sweep_start_given) choice.sweep_start = sweeps.start;  // an explicit one wins
+      string decision = Diameter::DescribeChoice(stats, choice);
+      fprintf(stderr, "%s\n", decision.c_str());
+
+      // Only for the chosen engine; the engines compared after it get the
+      // thread count the run started with
+      int default_threads = omp_get_max_threads();
+      omp_set_num_threads(choice.num_threads);
+      Diameter::SweepOptions auto_sweeps = sweeps;
+      auto_sweeps.start = choice.sweep_start;
+      int diam = 0;
+      switch (choice.engine) {
+        case Diameter::ENGINE_PARA_PAPER:
+          solver.SetDirectionTuning(choice.tune_direction);
+          solver.SetSweeps(auto_sweeps);
+          solver.SetCheckpoint(checkpoint_file, checkpoint_interval);
+          solver.SetWhiskerDepths(depth);
+          diam = solver.GetDiameter();
+          break;
+        case Diameter::ENGINE_PARA_SLOW:
+          diam = Diameter::GetBruteDiamParallel(padjlist, choice.tune_direction, depth);
+          break;
+        case Diameter::ENGINE_PAPER:
+          adjlist = Diameter::BuildGraph(edges, simplify_lists);
+          diam = Diameter::GetFastDiam(adjlist, checkpoint_file, checkpoint_interval, auto_sweeps,
+                                       depth);
+          break;
+        case Diameter::ENGINE_SLOW:
+          adjlist = Diameter::BuildGraph(edges, simplify_lists);
+          diam = Diameter::GetBruteDiam(adjlist, depth);
+          break;
+      }
+      diam = max(diam, whisker_diameter);
+      double seconds = GetTime() - start;
+      omp_set_num_threads(default_threads);
+      printf("\nThe automatically selected %s engine says"
+             " the diameter of the graph is: %d \n\n", Diameter::EngineName(choice.engine), diam);
+      printf("This auto-selected operation was completed in:                %f seconds \n\n",
+             seconds);
+
+      // Decision and outcome together, for reviewing the cost model later
+      if (auto_log != NULL) {
+        FILE *log = fopen(auto_log, "a");
+        if (log == NULL) {
+            fprintf(stderr, "Can't open %s\n", auto_log);
+        } else {
+          fprintf(log, "%s\t%s | diameter=%d seconds=%f\n", filename, decision.c_str(), diam,
+                  seconds);
+          fclose(log);
+        }
+      }
+    }
     if (run_paper) {
-      fast_diam_time = RunTrials(adjlist, &Diameter::GetFastDiam, trials);
+      fast_diam_time = RunTrials(adjlist, [&](const vector <vector<int> > &graph) {
+        return max(Diameter::GetFastDiam(graph, checkpoint_file, checkpoint_interval, sweeps, depth),
+                   whisker_diameter);
+      }, trials);
       printf("\nAccording to the solution by @kawatea,"
              " the diameter of the graph is: %d \n\n", fast_diam_time.first);
       printf("This operation from the paper was completed in:               %f seconds \n\n",
              fast_diam_time.second);
     }
     if (run_slow) {
-      brute_diam_time = RunTrials(adjlist, &Diameter::GetBruteDiam, trials);
+      if (lanes > 0) {
+        brute_diam_time = RunTrials(adjlist, [&](const vector <vector<int> > &graph) {
+          return max(Diameter::GetBruteDiamInterleaved(graph, lanes, depth), whisker_diameter);
+        }, trials);
+      } else {
+        brute_diam_time = RunTrials(adjlist, [&](const vector <vector<int> > &graph) {
+          return max(Diameter::GetBruteDiam(graph, depth), whisker_diameter);
+        }, trials);
+      }
       printf("A trivial, yet exact, solution says"
              " the diameter of the graph is: %d \n\n", brute_diam_time.first);
       printf("This brute force operation was completed in:                  %f seconds \n\n",
              brute_diam_time.second);
     }
     if (run_para_slow) {
-      brute_para_diam_time = RunTrials(padjlist, SLOW_PARA, trials);
+      brute_para_diam_time = RunTrials(padjlist, SLOW_PARA, trials, tune_direction,
+                                       checkpoint_file, checkpoint_interval, sweeps,
+                                       segment_width, depth);
+      brute_para_diam_time.first = max(brute_para_diam_time.first, whisker_diameter);
       printf("The experimental, yet trivial solution says"
              " the diameter of the graph is: %d \n\n", brute_para_diam_time.first);
       printf("This parallelized brute force operation was completed in:     %f seconds \n\n",
              brute_para_diam_time.second);
     }
     if (run_para_paper) {
-      paper_para_diam_time = RunTrials(padjlist, PAPER_PARA, trials);
+      paper_para_diam_time = RunTrials(padjlist, PAPER_PARA, trials, tune_direction,
+                                       checkpoint_file, checkpoint_interval, sweeps,
+                                       segment_width, depth);
+      paper_para_diam_time.first = max(paper_para_diam_time.first, whisker_diameter);
       printf("The experimental, paper-modifying solution says"
              " the diameter of the graph is: %d \n\n", paper_para_diam_time.first);
       printf("This parallelized paper-modifying operation was completed in: %f seconds \n\n",
              paper_para_diam_time.second);
     }
+    if (use_solver) {
+      // One solver answers every query, sharing its transpose and SCCs
+      Diameter::DiameterSolver solver(padjlist, tune_direction);
+      solver.SetSweeps(sweeps);
+      solver.SetSegmentWidth(segment_width);
+      for (long long id : ecc_queries) {
+        int v;
+        if (!ids.ToDense(id, padjlist.size(), v)) {
+          fprintf(stderr, "Vertex %lld is not in the graph\n", id);
+          continue;
+        }
+        printf("The eccentricity of vertex %lld is: %d \n\n", id, solver.GetEccentricity(v));
+      }
+      if (run_radius) {
+        double start = GetTime();
+        int radius = solver.GetRadius();
+        printf("The radius of the graph is: %d \n\n", radius);
+        printf("This radius search was completed in:                          %f seconds \n\n",
+               GetTime() - start);
+      }
+      if (scc_table) {
+        // Every SCC with a path in it, largest first
+        double start = GetTime();
+        vector<Diameter::ComponentDiameter> table = solver.GetComponentDiameters();
+        printf("component\tsize\tdiameter\n");
+        for (const Diameter::ComponentDiameter &row : table) {
+          printf("%d\t%d\t%d\n", row.component, row.size, row.diameter);
+        }
+        printf("\nThis per-SCC diameter table was completed in:                 %f seconds \n\n",
+               GetTime() - start);
+      }
+      // The graph stays loaded and every answer stays cached between queries
+      fflush(stdout);
+      if (socket_path != NULL) {
+        fprintf(stderr, "Serving queries on %s\n", socket_path);
+        if (!Diameter::ServeSocket(solver, ids, socket_path)) {
+            fprintf(stderr, "Can't listen on %s\n", socket_path);
+            return -1;
+        }
+      } else if (serve_stdin) {
+        Diameter::ServeStream(solver, ids, stdin, stdout);
+      }
+    }
+    if (semiext_filename != NULL) {
+      double start = GetTime();
+      int diam = Diameter::GetSemiExternalDiam(semiext_filename);
+      if (diam < 0) {
+        fprintf(stderr, "Can't open disk CSR %s\n", semiext_filename);
+        return -1;
+      }
+      printf("The semi-external solution over %s says"
+             " the diameter of the graph is: %d \n\n", semiext_filename, diam);
+      printf("This semi-external operation was completed in:                %f seconds \n\n",
+             GetTime() - start);
+    }
   }
   return 0;
 }